@@ -0,0 +1,227 @@
+// Stress test and benchmark for b2ThreadBlockAllocator. Every thread
+// allocates and frees blocks of random sizes and hands some of them to the
+// next thread, which frees them, so blocks cross between thread caches.
+// The same work is then timed on one b2BlockAllocator behind a mutex.
+//
+// Every block is filled with a byte derived from its size and checked when
+// it is freed, so a block handed out twice shows up as a corrupt block.
+// After the threads finish and flush, no bytes may be live.
+//
+// Usage: AllocatorBench [threads] [operations per thread]
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "Box2D/Box2D.h"
+
+using namespace std;
+
+// Some sizes go past b2_maxBlockSize to cover the b2Alloc path.
+const int MAX_ALLOCATION_SIZE = 700;
+const int MAX_LIVE_BLOCKS = 256;
+
+struct Allocation {
+  void* memory;
+  int size;
+};
+
+// Blocks handed from one thread to the next.
+struct Mailbox {
+  mutex lock;
+  vector<Allocation> allocations;
+};
+
+// The allocator under test and the locked baseline, behind one interface.
+class ThreadedAllocator {
+ private:
+  b2ThreadBlockAllocator allocator;
+
+ public:
+  ThreadedAllocator(int threadCount) : allocator(threadCount) {}
+
+  void* allocate(int size, int threadIndex) {
+    return allocator.Allocate(size, threadIndex);
+  }
+
+  void free(void* memory, int size, int threadIndex) {
+    allocator.Free(memory, size, threadIndex);
+  }
+
+  void finish(int threadCount, b2BlockAllocatorStats* stats) {
+    for (int i = 0; i < threadCount; i++) {
+      allocator.Flush(i);
+    }
+    allocator.GetStats(stats);
+  }
+};
+
+class LockedAllocator {
+ private:
+  b2BlockAllocator allocator;
+  mutex lock;
+
+ public:
+  LockedAllocator(int) {}
+
+  void* allocate(int size, int) {
+    lock_guard<mutex> guard(lock);
+    return allocator.Allocate(size);
+  }
+
+  void free(void* memory, int size, int) {
+    lock_guard<mutex> guard(lock);
+    allocator.Free(memory, size);
+  }
+
+  void finish(int, b2BlockAllocatorStats* stats) {
+    allocator.GetStats(stats);
+  }
+};
+
+unsigned int nextRandom(unsigned int& state) {
+  state = state * 1664525u + 1013904223u;
+  return state >> 8;
+}
+
+void fill(const Allocation& allocation) {
+  memset(allocation.memory, allocation.size & 0xFF, allocation.size);
+}
+
+bool check(const Allocation& allocation) {
+  const unsigned char* bytes = (const unsigned char*) allocation.memory;
+  for (int i = 0; i < allocation.size; i++) {
+    if (bytes[i] != (allocation.size & 0xFF)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+void work(T& allocator, vector<Mailbox>& mailboxes, int threadIndex, int operations,
+          atomic<int>& corruptBlocks) {
+  int threadCount = (int) mailboxes.size();
+  Mailbox& inbox = mailboxes[threadIndex];
+  Mailbox& outbox = mailboxes[(threadIndex + 1) % threadCount];
+  unsigned int state = 1234 + threadIndex;
+
+  vector<Allocation> live;
+  vector<Allocation> received;
+  for (int i = 0; i < operations; i++) {
+    if (live.size() < MAX_LIVE_BLOCKS && nextRandom(state) % 2 == 0) {
+      Allocation allocation;
+      allocation.size = 1 + nextRandom(state) % MAX_ALLOCATION_SIZE;
+      allocation.memory = allocator.allocate(allocation.size, threadIndex);
+      fill(allocation);
+      live.push_back(allocation);
+    } else if (!live.empty()) {
+      int index = nextRandom(state) % live.size();
+      Allocation allocation = live[index];
+      live[index] = live.back();
+      live.pop_back();
+
+      if (nextRandom(state) % 4 == 0) {
+        lock_guard<mutex> guard(outbox.lock);
+        outbox.allocations.push_back(allocation);
+        continue;
+      }
+
+      if (!check(allocation)) {
+        corruptBlocks++;
+      }
+      allocator.free(allocation.memory, allocation.size, threadIndex);
+    }
+
+    if (i % 64 == 0) {
+      {
+        lock_guard<mutex> guard(inbox.lock);
+        received.swap(inbox.allocations);
+      }
+      for (const Allocation& allocation : received) {
+        if (!check(allocation)) {
+          corruptBlocks++;
+        }
+        allocator.free(allocation.memory, allocation.size, threadIndex);
+      }
+      received.clear();
+    }
+  }
+
+  for (const Allocation& allocation : live) {
+    if (!check(allocation)) {
+      corruptBlocks++;
+    }
+    allocator.free(allocation.memory, allocation.size, threadIndex);
+  }
+}
+
+// Returns false if a block was corrupt or any bytes are live at the end.
+template <typename T>
+bool run(const char* name, int threadCount, int operations) {
+  T allocator(threadCount);
+  vector<Mailbox> mailboxes(threadCount);
+  atomic<int> corruptBlocks(0);
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  vector<thread> threads;
+  for (int i = 0; i < threadCount; i++) {
+    threads.push_back(thread([&allocator, &mailboxes, i, operations, &corruptBlocks] {
+      work(allocator, mailboxes, i, operations, corruptBlocks);
+    }));
+  }
+  for (thread& t : threads) {
+    t.join();
+  }
+  Uint64 end = SDL_GetPerformanceCounter();
+
+  // Blocks still in a mailbox are freed by the thread index they were sent
+  // to. The threads have stopped, so the indices are free to use here.
+  for (int i = 0; i < threadCount; i++) {
+    for (const Allocation& allocation : mailboxes[i].allocations) {
+      if (!check(allocation)) {
+        corruptBlocks++;
+      }
+      allocator.free(allocation.memory, allocation.size, i);
+    }
+  }
+
+  b2BlockAllocatorStats stats;
+  allocator.finish(threadCount, &stats);
+
+  int liveBlocks = 0;
+  for (int i = 0; i < b2_blockSizes; i++) {
+    liveBlocks += stats.liveBlocks[i];
+  }
+
+  float milliseconds = (end - start) * 1000.0f / SDL_GetPerformanceFrequency();
+  printf("%-7s %9.3f ms %8.1f ns/op   %d chunks, %d live blocks, %d live bytes, %d large, %d corrupt\n",
+         name, milliseconds, milliseconds * 1000000.0f / ((float) operations * threadCount),
+         stats.chunkCount, liveBlocks, stats.liveBytes, stats.largeCount, corruptBlocks.load());
+
+  return corruptBlocks.load() == 0 && liveBlocks == 0 && stats.liveBytes == 0 && stats.largeCount == 0;
+}
+
+int main(int argc, char* args[]) {
+  int threads = argc > 1 ? atoi(args[1]) : 4;
+  int operations = argc > 2 ? atoi(args[2]) : 1000000;
+  if (threads <= 0 || operations <= 0) {
+    LOG("Thread and operation counts must be positive\n");
+    return 1;
+  }
+
+  printf("%d threads, %d operations each\n", threads, operations);
+  bool passed = run<ThreadedAllocator>("cached", threads, operations);
+  passed = run<LockedAllocator>("locked", threads, operations) && passed;
+
+  if (!passed) {
+    LOG("Allocator stress test failed\n");
+    return 1;
+  }
+  return 0;
+}
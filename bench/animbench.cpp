@@ -0,0 +1,156 @@
+// Animation loading benchmark. Generates Aseprite-style sprite sheet exports
+// and times the streaming loader against the nlohmann::json DOM loader it
+// replaced.
+//
+// Usage: AnimBench [framesPerSheet] [sheets]
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "animation.h"
+#include "common.h"
+#include "json.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+// The previous loadAnimationData, minus the file read.
+bool parseAnimationDataDom(const string& text, unique_ptr<AnimationData>* animationData) {
+  json animationJson = json::parse(text);
+
+  auto framesItr = animationJson.find("frames");
+  if (framesItr == animationJson.end() || !framesItr.value().is_array()) {
+    return false;
+  }
+
+  const json& frames = framesItr.value();
+  vector<AnimationFrame> animationFrames;
+  for (size_t i = 0; i < frames.size(); i++) {
+    json frame = frames[i];
+    int duration = frame.at("duration");
+    json frameData = frame.at("frame");
+
+    SDL_Rect rect;
+    rect.x = frameData.at("x");
+    rect.y = frameData.at("y");
+    rect.w = frameData.at("w");
+    rect.h = frameData.at("h");
+
+    animationFrames.push_back(AnimationFrame(duration, rect));
+  }
+
+  string texturePath = animationJson.at("meta").at("image");
+  *animationData = unique_ptr<AnimationData>(new AnimationData(texturePath, move(animationFrames)));
+  return true;
+}
+
+// Same layout as Aseprite's "Array" export, including the fields the loaders
+// skip.
+string generateSheet(int sheet, int frameCount) {
+  string text = "{ \"frames\": [\n";
+  char buf[512];
+  for (int i = 0; i < frameCount; i++) {
+    snprintf(buf, sizeof(buf),
+             "   {\n"
+             "    \"filename\": \"Sheet%d %d.aseprite\",\n"
+             "    \"frame\": { \"x\": %d, \"y\": %d, \"w\": 32, \"h\": 32 },\n"
+             "    \"rotated\": false,\n"
+             "    \"trimmed\": false,\n"
+             "    \"spriteSourceSize\": { \"x\": 0, \"y\": 0, \"w\": 32, \"h\": 32 },\n"
+             "    \"sourceSize\": { \"w\": 32, \"h\": 32 },\n"
+             "    \"duration\": %d\n"
+             "   }%s\n",
+             sheet, i, (i % 64) * 32, (i / 64) * 32, 100 + i % 50,
+             i + 1 < frameCount ? "," : "");
+    text += buf;
+  }
+
+  snprintf(buf, sizeof(buf),
+           " ],\n"
+           " \"meta\": {\n"
+           "  \"app\": \"http://www.aseprite.org/\",\n"
+           "  \"version\": \"1.2.4\",\n"
+           "  \"image\": \"Sheet%d.png\",\n"
+           "  \"format\": \"RGBA8888\",\n"
+           "  \"size\": { \"w\": 2048, \"h\": 2048 },\n"
+           "  \"scale\": \"1\",\n"
+           "  \"frameTags\": [\n"
+           "  ]\n"
+           " }\n"
+           "}\n",
+           sheet);
+  text += buf;
+  return text;
+}
+
+bool sameAnimation(const AnimationData& a, const AnimationData& b) {
+  if (a.getTexturePath() != b.getTexturePath() || a.getFrames().size() != b.getFrames().size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a.getFrames().size(); i++) {
+    const AnimationFrame& frameA = a.getFrames()[i];
+    const AnimationFrame& frameB = b.getFrames()[i];
+    if (frameA.getDuration() != frameB.getDuration() ||
+        !SDL_RectEquals(&frameA.getFrame(), &frameB.getFrame())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* args[]) {
+  int frameCount = argc > 1 ? atoi(args[1]) : 2000;
+  int sheetCount = argc > 2 ? atoi(args[2]) : 40;
+  if (frameCount <= 0 || sheetCount <= 0) {
+    LOG("Frame and sheet counts must be positive\n");
+    return 1;
+  }
+
+  vector<string> sheets;
+  size_t totalBytes = 0;
+  for (int i = 0; i < sheetCount; i++) {
+    sheets.push_back(generateSheet(i, frameCount));
+    totalBytes += sheets.back().size();
+  }
+
+  LOG("Loading %d sheets of %d frames (%.1f MB)\n", sheetCount, frameCount, totalBytes / 1048576.0);
+
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+  vector<unique_ptr<AnimationData>> domResults(sheetCount);
+  vector<unique_ptr<AnimationData>> streamResults(sheetCount);
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  for (int i = 0; i < sheetCount; i++) {
+    if (!parseAnimationDataDom(sheets[i], &domResults[i])) {
+      LOG("DOM loader failed on sheet %d\n", i);
+      return 1;
+    }
+  }
+  double domMillis = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+  start = SDL_GetPerformanceCounter();
+  for (int i = 0; i < sheetCount; i++) {
+    if (!parseAnimationData(sheets[i].c_str(), sheets[i].size(), &streamResults[i])) {
+      LOG("Streaming loader failed on sheet %d\n", i);
+      return 1;
+    }
+  }
+  double streamMillis = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+  for (int i = 0; i < sheetCount; i++) {
+    if (!sameAnimation(*domResults[i], *streamResults[i])) {
+      LOG("Loaders disagree on sheet %d\n", i);
+      return 1;
+    }
+  }
+
+  printf("DOM loader:       %9.2f ms  (%7.1f MB/s)\n", domMillis, totalBytes / 1048576.0 / (domMillis / 1000.0));
+  printf("Streaming loader: %9.2f ms  (%7.1f MB/s)\n", streamMillis, totalBytes / 1048576.0 / (streamMillis / 1000.0));
+  printf("Speedup:          %9.2fx\n", domMillis / streamMillis);
+
+  return 0;
+}
@@ -0,0 +1,213 @@
+// Broad-phase backend benchmark. Builds the same scenes into one world per
+// b2BroadPhaseType and times the steps, to help pick the backend for a
+// level from what is in it.
+//
+// Usage: BroadPhaseBench [steps] [bodies]
+//
+// The defaults, 300 steps of 4000 bodies, are the settings the sweep and
+// prune backend was measured with when it was added.
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "common.h"
+#include "Box2D/Box2D.h"
+
+using namespace std;
+
+const unsigned int SCENE_SEED = 1234;
+
+float randomRange(float low, float high) {
+  return low + (high - low) * (rand() / (float) RAND_MAX);
+}
+
+// Static boxes in 8m chunks, like the colliders of a tile map.
+void createWalls(b2World& world, float width, float height) {
+  const float chunkLength = 8.0f;
+  for (float x = 0.0f; x < width; x += chunkLength) {
+    b2BodyDef bodyDef;
+    bodyDef.position.Set(x + chunkLength / 2.0f, 0.0f);
+    b2Body* body = world.CreateBody(&bodyDef);
+
+    b2PolygonShape box;
+    box.SetAsBox(chunkLength / 2.0f, 0.5f, b2Vec2(0.0f, -0.5f), 0.0f);
+    body->CreateFixture(&box, 0.0f);
+    box.SetAsBox(chunkLength / 2.0f, 0.5f, b2Vec2(0.0f, height + 0.5f), 0.0f);
+    body->CreateFixture(&box, 0.0f);
+  }
+
+  b2BodyDef bodyDef;
+  b2Body* body = world.CreateBody(&bodyDef);
+  b2PolygonShape box;
+  box.SetAsBox(0.5f, height / 2.0f, b2Vec2(-0.5f, height / 2.0f), 0.0f);
+  body->CreateFixture(&box, 0.0f);
+  box.SetAsBox(0.5f, height / 2.0f, b2Vec2(width + 0.5f, height / 2.0f), 0.0f);
+  body->CreateFixture(&box, 0.0f);
+}
+
+// Small boxes flying around a long corridor without gravity or losing
+// energy, so every body moves on every step.
+void createDebris(b2World& world, int count, float width, float height) {
+  b2FixtureDef fixtureDef;
+  fixtureDef.density = 1.0f;
+  fixtureDef.friction = 0.0f;
+  fixtureDef.restitution = 1.0f;
+
+  for (int i = 0; i < count; i++) {
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_dynamicBody;
+    bodyDef.position.Set(randomRange(1.0f, width - 1.0f), randomRange(1.0f, height - 1.0f));
+    bodyDef.linearVelocity.Set(randomRange(-10.0f, 10.0f), randomRange(-10.0f, 10.0f));
+    bodyDef.allowSleep = false;
+
+    b2PolygonShape box;
+    float halfSize = randomRange(0.1f, 0.2f);
+    box.SetAsBox(halfSize, halfSize);
+    fixtureDef.shape = &box;
+    world.CreateBody(&bodyDef)->CreateFixture(&fixtureDef);
+  }
+}
+
+float corridorWidth(int bodies) {
+  return bodies / 8.0f;
+}
+
+void buildDebris(b2World& world, int bodies) {
+  world.SetGravity(b2Vec2(0.0f, 0.0f));
+  createWalls(world, corridorWidth(bodies), 12.0f);
+  createDebris(world, bodies, corridorWidth(bodies), 12.0f);
+}
+
+// Columns of boxes that fall, settle and go to sleep.
+void buildPile(b2World& world, int bodies) {
+  world.SetGravity(b2Vec2(0.0f, -10.0f));
+  int columns = max(bodies / 40, 1);
+  createWalls(world, columns * 2.0f, 100.0f);
+
+  b2PolygonShape box;
+  box.SetAsBox(0.4f, 0.4f);
+
+  b2FixtureDef fixtureDef;
+  fixtureDef.shape = &box;
+  fixtureDef.density = 1.0f;
+  fixtureDef.friction = 0.6f;
+
+  for (int i = 0; i < bodies; i++) {
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_dynamicBody;
+    bodyDef.position.Set((i % columns) * 2.0f + 1.0f + randomRange(-0.1f, 0.1f), 0.5f + (i / columns) * 0.9f);
+    world.CreateBody(&bodyDef)->CreateFixture(&fixtureDef);
+  }
+}
+
+// The debris scene plus a few wide kinematic platforms sweeping up and down,
+// which is the worst case for sorting along x.
+void buildPlatforms(b2World& world, int bodies) {
+  buildDebris(world, bodies);
+
+  float width = corridorWidth(bodies);
+  b2PolygonShape box;
+  box.SetAsBox(10.0f, 0.25f);
+
+  for (float x = 10.0f; x < width; x += 40.0f) {
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_kinematicBody;
+    bodyDef.position.Set(x, randomRange(2.0f, 10.0f));
+    bodyDef.linearVelocity.Set(0.0f, randomRange(-2.0f, 2.0f));
+    world.CreateBody(&bodyDef)->CreateFixture(&box, 0.0f);
+  }
+}
+
+// Turns the platforms around before they reach the walls.
+void bouncePlatforms(b2World& world) {
+  for (b2Body* body = world.GetBodyList(); body != NULL; body = body->GetNext()) {
+    if (body->GetType() != b2_kinematicBody) {
+      continue;
+    }
+    b2Vec2 velocity = body->GetLinearVelocity();
+    float y = body->GetPosition().y;
+    if ((y < 2.0f && velocity.y < 0.0f) || (y > 10.0f && velocity.y > 0.0f)) {
+      body->SetLinearVelocity(-velocity);
+    }
+  }
+}
+
+struct Scene {
+  const char* name;
+  void (*build)(b2World& world, int bodies);
+};
+
+struct Result {
+  float average;
+  float p50;
+  float p90;
+  int contacts;
+};
+
+Result run(const Scene& scene, b2BroadPhaseType type, int steps, int bodies) {
+  b2World world(b2Vec2(0.0f, 0.0f), type);
+  srand(SCENE_SEED);
+  scene.build(world, bodies);
+
+  vector<float> stepTimes;
+  stepTimes.reserve(steps);
+  float total = 0.0f;
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+
+  for (int i = 0; i < steps; i++) {
+    bouncePlatforms(world);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    world.Step(PHYSICS_TIME_STEP, PHYSICS_VELOCITY_ITERATIONS, PHYSICS_POSITION_ITERATIONS);
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    float time = (end - start) * 1000.0f / frequency;
+    stepTimes.push_back(time);
+    total += time;
+  }
+
+  sort(stepTimes.begin(), stepTimes.end());
+  Result result;
+  result.average = total / steps;
+  result.p50 = stepTimes[stepTimes.size() / 2];
+  result.p90 = stepTimes[(stepTimes.size() * 9) / 10];
+  result.contacts = world.GetContactCount();
+  return result;
+}
+
+int main(int argc, char* args[]) {
+  int steps = argc > 1 ? atoi(args[1]) : 300;
+  int bodies = argc > 2 ? atoi(args[2]) : 4000;
+  if (steps <= 0 || bodies <= 0) {
+    LOG("Step and body counts must be positive\n");
+    return 1;
+  }
+
+  Scene scenes[] = {
+    { "debris", buildDebris },
+    { "pile", buildPile },
+    { "platforms", buildPlatforms },
+  };
+
+  struct {
+    const char* name;
+    b2BroadPhaseType type;
+  } backends[] = {
+    { "tree", b2_treeBroadPhase },
+    { "sweep", b2_sweepBroadPhase },
+  };
+
+  printf("Stepping %d bodies for %d steps\n", bodies, steps);
+  printf("%-10s %-6s %9s %9s %9s %9s\n", "scene", "type", "avg ms", "p50 ms", "p90 ms", "contacts");
+  for (const Scene& scene : scenes) {
+    for (const auto& backend : backends) {
+      Result result = run(scene, backend.type, steps, bodies);
+      printf("%-10s %-6s %9.3f %9.3f %9.3f %9d\n", scene.name, backend.name,
+             result.average, result.p50, result.p90, result.contacts);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,193 @@
+// Headless physics benchmark. Builds the same world runGame() uses, without
+// opening a window, and steps it with scripted input.
+//
+// Usage: GameBench [steps] [extraBodies] [threads] [wide]
+//
+// With more than one thread, islands are solved on a b2ThreadPool. A
+// non-zero wide uses the SIMD contact solver.
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "fonts.h"
+#include "tiles.h"
+#include "render.h"
+#include "assets.h"
+#include "common.h"
+#include "world.h"
+#include "Box2D/Box2D.h"
+
+using namespace std;
+
+const int PLAYER_SIZE = 32;
+
+// Cycles right, jump, left, idle so the player keeps touching the tiles.
+PlayerInput scriptedInput(int step) {
+  PlayerInput input;
+  switch ((step / 90) % 4) {
+    case 0:
+      input.right = true;
+      break;
+    case 1:
+      input.up = step % 90 < 10;
+      break;
+    case 2:
+      input.left = true;
+      break;
+    default:
+      break;
+  }
+  return input;
+}
+
+// Drops extra boxes above the level to put load on the solver.
+void createExtraBodies(b2World& world, int count) {
+  b2PolygonShape box;
+  box.SetAsBox(PLAYER_SIZE * PIXELS_TO_B2_UNITS / 4.0f, PLAYER_SIZE * PIXELS_TO_B2_UNITS / 4.0f);
+
+  b2FixtureDef fixtureDef;
+  fixtureDef.shape = &box;
+  fixtureDef.density = 1.0f;
+  fixtureDef.friction = 0.3f;
+
+  for (int i = 0; i < count; i++) {
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_dynamicBody;
+    bodyDef.position.Set((160 + (i % 20) * 16) * PIXELS_TO_B2_UNITS,
+                         -(100 - (i / 20) * 16) * PIXELS_TO_B2_UNITS);
+    world.CreateBody(&bodyDef)->CreateFixture(&fixtureDef);
+  }
+}
+
+float percentile(const vector<float>& sorted, float p) {
+  if (sorted.empty()) {
+    return 0.0f;
+  }
+  size_t index = (size_t) (p * (sorted.size() - 1) + 0.5f);
+  return sorted[index];
+}
+
+void printProfileLine(const char* name, float total, float max, int steps) {
+  printf("  %-14s avg %8.4f ms   max %8.4f ms\n", name, total / steps, max);
+}
+
+int main(int argc, char* args[]) {
+  int steps = argc > 1 ? atoi(args[1]) : 3600;
+  int extraBodies = argc > 2 ? atoi(args[2]) : 0;
+  int threads = argc > 3 ? atoi(args[3]) : 1;
+  bool wide = argc > 4 && atoi(args[4]) != 0;
+  if (steps <= 0 || threads <= 0) {
+    LOG("Step and thread counts must be positive\n");
+    return 1;
+  }
+
+  b2Vec2 gravity(0.0f, WORLD_GRAVITY);
+  b2World world(gravity);
+
+  world.SetWideSolver(wide);
+
+  b2ThreadPool threadPool(threads);
+  if (threads > 1) {
+    world.SetTaskExecutor(&threadPool);
+  }
+
+  // The tile instance is never rendered, so it does not need a texture.
+  shared_ptr<TileInstance> tileInstance =
+      shared_ptr<TileInstance>(new TileInstance(shared_ptr<TileDefinition>(), shared_ptr<Texture>()));
+
+  TileMap tileMap = TileMap(20, 20, 32);
+  createLevel(tileMap, tileInstance);
+
+  TileColliders tileColliders(world, tileMap);
+  tileColliders.update();
+
+  b2Body* playerBody = createPlayerBody(world, PLAYER_SIZE, PLAYER_SIZE);
+  createExtraBodies(world, extraBodies);
+
+  LOG("Stepping %d bodies for %d steps on %d threads with the %s contact solver\n",
+      world.GetBodyCount(), steps, threads, wide ? "wide" : "scalar");
+
+  vector<float> stepTimes;
+  stepTimes.reserve(steps);
+
+  b2Profile total = {};
+  b2Profile max = {};
+  int lastStackGrowStep = -1;
+  float frameDuration = PHYSICS_TIME_STEP * 1000.0f;
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+
+  for (int i = 0; i < steps; i++) {
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    applyPlayerInput(playerBody, scriptedInput(i), frameDuration);
+    world.Step(PHYSICS_TIME_STEP, PHYSICS_VELOCITY_ITERATIONS, PHYSICS_POSITION_ITERATIONS);
+
+    Uint64 end = SDL_GetPerformanceCounter();
+    stepTimes.push_back((end - start) * 1000.0f / frequency);
+
+    const b2Profile& profile = world.GetProfile();
+    total.step += profile.step;
+    total.collide += profile.collide;
+    total.solve += profile.solve;
+    total.solveInit += profile.solveInit;
+    total.solveVelocity += profile.solveVelocity;
+    total.solvePosition += profile.solvePosition;
+    total.broadphase += profile.broadphase;
+    total.solveTOI += profile.solveTOI;
+
+    max.step = b2Max(max.step, profile.step);
+    max.collide = b2Max(max.collide, profile.collide);
+    max.solve = b2Max(max.solve, profile.solve);
+    max.solveInit = b2Max(max.solveInit, profile.solveInit);
+    max.solveVelocity = b2Max(max.solveVelocity, profile.solveVelocity);
+    max.solvePosition = b2Max(max.solvePosition, profile.solvePosition);
+    max.broadphase = b2Max(max.broadphase, profile.broadphase);
+    max.solveTOI = b2Max(max.solveTOI, profile.solveTOI);
+
+    max.stackPeak = b2Max(max.stackPeak, profile.stackPeak);
+    total.stackGrowCount += profile.stackGrowCount;
+    if (profile.stackGrowCount > 0) {
+      lastStackGrowStep = i;
+    }
+  }
+
+  sort(stepTimes.begin(), stepTimes.end());
+
+  printf("Step wall time (%d steps):\n", steps);
+  printf("  p50 %8.4f ms   p90 %8.4f ms   p99 %8.4f ms   max %8.4f ms\n",
+         percentile(stepTimes, 0.5f), percentile(stepTimes, 0.9f),
+         percentile(stepTimes, 0.99f), stepTimes.back());
+
+  printf("b2Profile:\n");
+  printProfileLine("step", total.step, max.step, steps);
+  printProfileLine("collide", total.collide, max.collide, steps);
+  printProfileLine("solve", total.solve, max.solve, steps);
+  printProfileLine("solveInit", total.solveInit, max.solveInit, steps);
+  printProfileLine("solveVelocity", total.solveVelocity, max.solveVelocity, steps);
+  printProfileLine("solvePosition", total.solvePosition, max.solvePosition, steps);
+  printProfileLine("broadphase", total.broadphase, max.broadphase, steps);
+  printProfileLine("solveTOI", total.solveTOI, max.solveTOI, steps);
+
+  printf("Stack allocator: peak %d bytes, %d heap allocations, the last in step %d\n",
+         max.stackPeak, total.stackGrowCount, lastStackGrowStep);
+
+  b2BlockAllocatorStats allocatorStats;
+  world.GetBlockAllocatorStats(&allocatorStats);
+  printf("Block allocator: %d chunks, %d bytes live, %d free, %d wasted, %d large allocations\n",
+         allocatorStats.chunkCount, allocatorStats.liveBytes, allocatorStats.freeBytes,
+         allocatorStats.wastedBytes, allocatorStats.largeCount);
+  for (int i = 0; i < b2_blockSizes; i++) {
+    if (allocatorStats.chunks[i] > 0) {
+      printf("  %3d byte blocks: %6d live in %3d chunks\n", b2BlockAllocator::GetBlockSize(i),
+             allocatorStats.liveBlocks[i], allocatorStats.chunks[i]);
+    }
+  }
+
+  b2Vec2 position = playerBody->GetPosition();
+  printf("Final player position: (%f, %f)\n", position.x, position.y);
+
+  return 0;
+}
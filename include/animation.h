@@ -0,0 +1,362 @@
+#ifndef ANIMATION_INCLUDED
+#define ANIMATION_INCLUDED
+
+#include <SDL.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "jsonreader.h"
+
+using namespace std;
+
+class AnimationFrame {
+private:
+	int duration;
+	SDL_Rect frame;
+
+public:
+	AnimationFrame(int duration, SDL_Rect frame) {
+		this->duration = duration;
+		this->frame = frame;
+	}
+
+	const SDL_Rect& getFrame() const {
+		return frame;
+	}
+
+	int getDuration() const {
+		return duration;
+	}
+};
+
+class AnimationData {
+private:
+	vector<AnimationFrame> frames;
+	string texturePath;
+
+public:
+	AnimationData(string texturePath, vector<AnimationFrame> frames) {
+		this->texturePath = texturePath;
+		this->frames = move(frames);
+	}
+
+	const vector<AnimationFrame>& getFrames() const {
+		return frames;
+	}
+
+	const string getTexturePath() const {
+		return texturePath;
+	}
+};
+
+// Instances per job when animations are updated in parallel.
+const int ANIMATION_JOB_SIZE = 1024;
+
+typedef int AnimationClipId;
+typedef int AnimationInstanceId;
+
+// A clip's frames, as a range of the AnimationSystem frame arrays.
+struct AnimationClip {
+	int firstFrame;
+	int frameCount;
+	int duration;
+};
+
+// Plays looping animations for many sprites at once. Clips are stored as
+// flat frame arrays and playing instances as parallel arrays, so update()
+// is a single pass over contiguous memory.
+//
+// Instance ids stay valid until stop() is called on them; internally the
+// instance arrays are kept dense by moving the last instance into the gap.
+class AnimationSystem {
+private:
+	// Frames of every clip, back to back.
+	vector<SDL_Rect> frameRects;
+	vector<int> frameDurations;
+	vector<AnimationClip> clips;
+
+	// One entry per playing instance.
+	vector<AnimationClipId> instanceClips;
+	vector<float> instanceElapsed;
+	vector<int> instanceFrames;
+
+	vector<int> idToIndex;
+	vector<AnimationInstanceId> indexToId;
+	vector<AnimationInstanceId> freeIds;
+
+public:
+	// Returns -1 if the animation has no frames.
+	AnimationClipId addClip(const AnimationData& animationData) {
+		const vector<AnimationFrame>& frames = animationData.getFrames();
+		if (frames.empty()) {
+			return -1;
+		}
+
+		AnimationClip clip = { (int) frameRects.size(), (int) frames.size(), 0 };
+		for (const AnimationFrame& frame : frames) {
+			// Zero length frames would stop update() from ever leaving them.
+			int duration = max(frame.getDuration(), 1);
+			frameRects.push_back(frame.getFrame());
+			frameDurations.push_back(duration);
+			clip.duration += duration;
+		}
+
+		clips.push_back(clip);
+		return (AnimationClipId) clips.size() - 1;
+	}
+
+	// Returns -1 if clip is not a clip of this system.
+	AnimationInstanceId play(AnimationClipId clip) {
+		if (clip < 0 || clip >= (AnimationClipId) clips.size()) {
+			return -1;
+		}
+
+		AnimationInstanceId id;
+		if (freeIds.empty()) {
+			id = (AnimationInstanceId) idToIndex.size();
+			idToIndex.push_back(0);
+		} else {
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+
+		idToIndex[id] = (int) instanceClips.size();
+		indexToId.push_back(id);
+		instanceClips.push_back(clip);
+		instanceElapsed.push_back(0.0f);
+		instanceFrames.push_back(clips[clip].firstFrame);
+		return id;
+	}
+
+	// Returns false if id is not a playing instance.
+	bool stop(AnimationInstanceId id) {
+		if (!isPlaying(id)) {
+			return false;
+		}
+
+		int index = idToIndex[id];
+		int last = (int) instanceClips.size() - 1;
+
+		instanceClips[index] = instanceClips[last];
+		instanceElapsed[index] = instanceElapsed[last];
+		instanceFrames[index] = instanceFrames[last];
+		indexToId[index] = indexToId[last];
+		idToIndex[indexToId[index]] = index;
+
+		instanceClips.pop_back();
+		instanceElapsed.pop_back();
+		instanceFrames.pop_back();
+		indexToId.pop_back();
+		freeIds.push_back(id);
+		return true;
+	}
+
+	// A stopped id still maps to its old index, which is either past the
+	// end or now belongs to another instance.
+	bool isPlaying(AnimationInstanceId id) const {
+		if (id < 0 || id >= (AnimationInstanceId) idToIndex.size()) {
+			return false;
+		}
+
+		int index = idToIndex[id];
+		return index < (int) indexToId.size() && indexToId[index] == id;
+	}
+
+	// Advances every playing instance by elapsedMillis.
+	void update(float elapsedMillis) {
+		update(elapsedMillis, 0, getInstanceCount());
+	}
+
+	// Advances instances [begin, end) only. Disjoint ranges can be updated
+	// from different threads.
+	void update(float elapsedMillis, int begin, int end) {
+		const AnimationClip* clipData = clips.data();
+		const int* durations = frameDurations.data();
+		AnimationClipId* clipIds = instanceClips.data();
+		float* elapsed = instanceElapsed.data();
+		int* currentFrames = instanceFrames.data();
+
+		for (int i = begin; i < end; i++) {
+			const AnimationClip& clip = clipData[clipIds[i]];
+			float time = elapsed[i] + elapsedMillis;
+			int frame = currentFrames[i];
+
+			// Whole loops land back on the same frame, so drop them first.
+			if (time >= clip.duration) {
+				time = fmodf(time, (float) clip.duration);
+			}
+
+			while (time >= durations[frame]) {
+				time -= durations[frame];
+				frame++;
+				if (frame == clip.firstFrame + clip.frameCount) {
+					frame = clip.firstFrame;
+				}
+			}
+
+			elapsed[i] = time;
+			currentFrames[i] = frame;
+		}
+	}
+
+	// Source rect of the frame the instance is showing.
+	const SDL_Rect& getFrame(AnimationInstanceId id) const {
+		return frameRects[instanceFrames[idToIndex[id]]];
+	}
+
+	int getInstanceCount() const {
+		return (int) instanceClips.size();
+	}
+};
+
+bool readAnimationRect(JsonReader& reader, SDL_Rect* rect) {
+	if (!reader.beginObject()) {
+		return false;
+	}
+
+	string key;
+	while (reader.nextKey(key)) {
+		bool read;
+		if (key == "x") {
+			read = reader.readInt(rect->x);
+		} else if (key == "y") {
+			read = reader.readInt(rect->y);
+		} else if (key == "w") {
+			read = reader.readInt(rect->w);
+		} else if (key == "h") {
+			read = reader.readInt(rect->h);
+		} else {
+			read = reader.skipValue();
+		}
+
+		if (!read) {
+			return false;
+		}
+	}
+	return reader.ok();
+}
+
+bool readAnimationFrame(JsonReader& reader, vector<AnimationFrame>& frames) {
+	if (!reader.beginObject()) {
+		return false;
+	}
+
+	int duration = -1;
+	SDL_Rect rect = { 0, 0, -1, -1 };
+
+	string key;
+	while (reader.nextKey(key)) {
+		bool read;
+		if (key == "duration") {
+			read = reader.readInt(duration);
+		} else if (key == "frame") {
+			read = readAnimationRect(reader, &rect);
+		} else {
+			read = reader.skipValue();
+		}
+
+		if (!read) {
+			return false;
+		}
+	}
+
+	if (!reader.ok() || duration < 0 || rect.w < 0 || rect.h < 0) {
+		LOG_STREAM() << "Error! Animation frame is missing 'duration' or 'frame'." << endl;
+		return false;
+	}
+
+	frames.push_back(AnimationFrame(duration, rect));
+	return true;
+}
+
+bool readAnimationMeta(JsonReader& reader, string* texturePath) {
+	if (!reader.beginObject()) {
+		return false;
+	}
+
+	string key;
+	while (reader.nextKey(key)) {
+		bool read = key == "image" ? reader.readString(*texturePath) : reader.skipValue();
+		if (!read) {
+			return false;
+		}
+	}
+	return reader.ok();
+}
+
+// Reads an Aseprite sprite sheet export (array layout) in a single pass over
+// the file, appending frames as they are reached.
+bool parseAnimationData(const char* text, size_t length, unique_ptr<AnimationData>* animationData) {
+	JsonReader reader(text, length);
+	if (!reader.beginObject()) {
+		LOG_STREAM() << "Error! Expected an object in animation json." << endl;
+		return false;
+	}
+
+	vector<AnimationFrame> frames;
+	string texturePath;
+	bool foundFrames = false;
+	bool foundMeta = false;
+
+	string key;
+	while (reader.nextKey(key)) {
+		if (key == "frames") {
+			if (!reader.isArray()) {
+				LOG_STREAM() << "Error! Expected 'frames' to be an array." << endl;
+				return false;
+			}
+
+			reader.beginArray();
+			while (reader.nextElement()) {
+				if (!readAnimationFrame(reader, frames)) {
+					return false;
+				}
+			}
+			foundFrames = true;
+		} else if (key == "meta") {
+			if (!readAnimationMeta(reader, &texturePath)) {
+				break;
+			}
+			foundMeta = true;
+		} else if (!reader.skipValue()) {
+			break;
+		}
+	}
+
+	if (!reader.ok() || !reader.finish()) {
+		LOG_STREAM() << "Error! Malformed animation json." << endl;
+		return false;
+	}
+
+	if (!foundFrames) {
+		LOG_STREAM() << "Error! Can't find 'frames' in animation json." << endl;
+		return false;
+	}
+
+	if (!foundMeta || texturePath.empty()) {
+		LOG_STREAM() << "Error! Can't find 'meta.image' in animation json." << endl;
+		return false;
+	}
+
+	*animationData = unique_ptr<AnimationData>(new AnimationData(texturePath, move(frames)));
+	return true;
+}
+
+bool loadAnimationData(string path, unique_ptr<AnimationData>* animationData) {
+	LOG_STREAM() << "Loading AnimationData for: " << path << endl;
+	ifstream file(path, ios::binary);
+	if (!file) {
+		LOG_STREAM() << "Error! Can't open " << path << endl;
+		return false;
+	}
+
+	string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	return parseAnimationData(text.c_str(), text.size(), animationData);
+}
+
+#endif
@@ -1,9 +1,16 @@
 #ifndef ASSETS_INCLUDED
 #define ASSETS_INCLUDED
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <string>
 #include "common.h"
+#include "animation.h"
+#include "atlas.h"
+#include "bundle.h"
 #include "fonts.h"
+#include "loader.h"
 #include "render.h"
 
 using namespace std;
@@ -12,10 +19,46 @@ class AssetManager;
 class TilePalette;
 
 bool loadFont(string, AssetManager*, shared_ptr<Font>*);
+bool createBundledFont(const BundleFont&, shared_ptr<Texture>, shared_ptr<Font>*);
 bool loadTilePalette(string, AssetManager&, shared_ptr<TilePalette>&);
 
 
+// Maximum number of decoded textures uploaded by one AssetManager::update.
+const int DEFAULT_TEXTURE_UPLOADS_PER_FRAME = 2;
+
+// A texture that may still be loading. Until the real texture is uploaded
+// getTexture returns a placeholder, so callers can render it right away. If
+// loading fails the handle keeps the placeholder and isFailed returns true.
+class TextureHandle {
+ private:
+  shared_ptr<Texture> texture;
+  bool ready;
+  bool failed;
+
+  friend class AssetManager;
+
+ public:
+  TextureHandle(shared_ptr<Texture> texture, bool ready) {
+    this->texture = texture;
+    this->ready = ready;
+    this->failed = false;
+  }
+
+  bool isReady() const {
+    return ready;
+  }
+
+  bool isFailed() const {
+    return failed;
+  }
+
+  shared_ptr<Texture> getTexture() const {
+    return texture;
+  }
+};
+
 typedef map<string, shared_ptr<Texture> > PathToTextureMap;
+typedef map<string, shared_ptr<TextureHandle> > PathToTextureHandleMap;
 typedef map<string, shared_ptr<Font> > PathToFontMap;
 typedef map<string, shared_ptr<TilePalette> > PathToTilePaletteMap;
 
@@ -27,19 +70,220 @@ class AssetManager {
 
   shared_ptr<Renderer> renderer;
 
+  // Textures requested through getTextureAsync that are not uploaded yet.
+  unique_ptr<PathToTextureHandleMap> pendingTextures;
+  shared_ptr<Texture> placeholderTexture;
+  // Cooked assets, looked up before the loose files under bundleRoot.
+  unique_ptr<AssetBundle> bundle;
+  string bundleRoot;
+
+  // Small images are packed into shared pages when atlasEnabled is set.
+  unique_ptr<TextureAtlas> atlas;
+  bool atlasEnabled;
+
+  // Created on the first async request. Declared after renderer so the
+  // worker threads are joined first.
+  unique_ptr<TextureDecoder> decoder;
+
  public:
   AssetManager(shared_ptr<Renderer> renderer) {
     textures = unique_ptr<PathToTextureMap>(new PathToTextureMap());
     fonts = unique_ptr<PathToFontMap>(new PathToFontMap());
     tilePalettes = unique_ptr<PathToTilePaletteMap>(new PathToTilePaletteMap());
+    pendingTextures = unique_ptr<PathToTextureHandleMap>(new PathToTextureHandleMap());
+    atlas = unique_ptr<TextureAtlas>(new TextureAtlas());
+    atlasEnabled = false;
 
     this->renderer = renderer;
   }
 
+  // When enabled, textures loaded from then on that are small enough are
+  // packed into shared atlas pages instead of getting their own texture.
+  void setAtlasEnabled(bool atlasEnabled) {
+    this->atlasEnabled = atlasEnabled;
+  }
+
+  const TextureAtlas& getAtlas() const {
+    return *atlas;
+  }
+
+  // Maps a bundle written by AssetCook. Afterwards, assets requested by a
+  // path under assetRoot (e.g. "../assets/") are served from the bundle
+  // when it contains them and from loose files otherwise.
+  bool loadBundle(const string& path, const string& assetRoot) {
+    unique_ptr<AssetBundle> newBundle = unique_ptr<AssetBundle>(new AssetBundle());
+    if (!newBundle->open(path)) {
+      return false;
+    }
+
+    bundle = move(newBundle);
+    bundleRoot = assetRoot;
+    return true;
+  }
+
+  // Name of an asset path inside the bundle, or "" if there is no bundle or
+  // the path is outside the bundle root.
+  string getBundleName(const string& path) const {
+    if (bundle.get() == NULL || path.compare(0, bundleRoot.size(), bundleRoot) != 0) {
+      return "";
+    }
+    return path.substr(bundleRoot.size());
+  }
+
+  bool loadBundledTexture(const BundleImage* image, shared_ptr<Texture>* texture) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(
+        (void*) AssetBundle::getPixels(image), image->width, image->height, 32,
+        image->pitch, SDL_PIXELFORMAT_RGBA8888);
+    if (surface == NULL) {
+      LOG("Unable to wrap bundled image! SDL Error: %s\n", SDL_GetError());
+      return false;
+    }
+
+    bool created = createTexture(surface, texture);
+    SDL_FreeSurface(surface);
+    return created;
+  }
+
+  bool loadBundledFont(const BundleFont* bundledFont, shared_ptr<Font>* font) {
+    shared_ptr<Texture> texture;
+    if (!getTexture(bundleRoot + bundle->getString(bundledFont->texture), &texture)) {
+      return false;
+    }
+
+    return createBundledFont(*bundledFont, texture, font);
+  }
+
+  // Loads Aseprite animation data, from the bundle when it is there.
+  bool getAnimationData(const string path, unique_ptr<AnimationData>* animationData) {
+    string name = getBundleName(path);
+    const BundleAnimation* animation = name.empty() ? NULL : bundle->findAnimation(name);
+    if (animation == NULL) {
+      return loadAnimationData(path, animationData);
+    }
+
+    vector<AnimationFrame> frames;
+    frames.reserve(animation->frameCount);
+
+    const BundleFrame* bundledFrames = AssetBundle::getFrames(animation);
+    for (Uint32 i = 0; i < animation->frameCount; i++) {
+      SDL_Rect rect = { bundledFrames[i].x, bundledFrames[i].y, bundledFrames[i].w, bundledFrames[i].h };
+      frames.push_back(AnimationFrame(bundledFrames[i].duration, rect));
+    }
+
+    *animationData = unique_ptr<AnimationData>(
+        new AnimationData(bundle->getString(animation->texture), move(frames)));
+    return true;
+  }
+
+  // Turns a decoded surface into a texture, in the atlas when possible.
+  bool createTexture(SDL_Surface* surface, shared_ptr<Texture>* texture) {
+    if (atlasEnabled && TextureAtlas::accepts(surface) &&
+        atlas->add(*renderer, surface, texture)) {
+      return true;
+    }
+
+    return renderer->createTexture(surface, texture);
+  }
+
+  // Starts loading a texture without blocking. The image is decoded on a
+  // worker thread and uploaded by a later call to update(); until then the
+  // handle holds a placeholder texture. Returns NULL if the placeholder
+  // cannot be created.
+  shared_ptr<TextureHandle> getTextureAsync(const string path) {
+    PathToTextureMap::iterator it = textures->find(path);
+    if (it != textures->end()) {
+      return shared_ptr<TextureHandle>(new TextureHandle(it->second, true));
+    }
+
+    PathToTextureHandleMap::iterator pending = pendingTextures->find(path);
+    if (pending != pendingTextures->end()) {
+      return pending->second;
+    }
+
+    // Bundled images are already decoded, so there is nothing to wait for.
+    string name = getBundleName(path);
+    if (!name.empty() && bundle->findImage(name) != NULL) {
+      shared_ptr<Texture> texture;
+      if (getTexture(path, &texture)) {
+        return shared_ptr<TextureHandle>(new TextureHandle(texture, true));
+      }
+    }
+
+    if (placeholderTexture.get() == NULL &&
+        !renderer->createSolidTexture(0xFF, 0x00, 0xFF, 0xFF, &placeholderTexture)) {
+      LOG("Error creating placeholder texture\n");
+      return shared_ptr<TextureHandle>();
+    }
+
+    if (decoder.get() == NULL) {
+      int threadCount = max(1, min(4, (int) thread::hardware_concurrency() - 1));
+      decoder = unique_ptr<TextureDecoder>(new TextureDecoder(threadCount));
+    }
+
+    shared_ptr<TextureHandle> handle =
+        shared_ptr<TextureHandle>(new TextureHandle(placeholderTexture, false));
+    (*pendingTextures)[path] = handle;
+    decoder->request(path);
+
+    return handle;
+  }
+
+  // Uploads up to maxUploads decoded textures. Call once per frame on the
+  // render thread.
+  void update(int maxUploads = DEFAULT_TEXTURE_UPLOADS_PER_FRAME) {
+    if (decoder.get() == NULL) {
+      return;
+    }
+
+    DecodedImage image;
+    for (int i = 0; i < maxUploads && decoder->poll(image); i++) {
+      PathToTextureHandleMap::iterator pending = pendingTextures->find(image.path);
+      shared_ptr<TextureHandle> handle = pending->second;
+      pendingTextures->erase(pending);
+
+      if (image.surface == NULL) {
+        LOG("Error loading texture: %s\n", image.path.c_str());
+        handle->failed = true;
+        continue;
+      }
+
+      // A synchronous getTexture may have loaded it in the meantime.
+      PathToTextureMap::iterator it = textures->find(image.path);
+      if (it != textures->end()) {
+        handle->texture = it->second;
+        handle->ready = true;
+      } else if (createTexture(image.surface, &handle->texture)) {
+        handle->ready = true;
+        (*textures)[image.path] = handle->texture;
+      } else {
+        handle->failed = true;
+      }
+
+      SDL_FreeSurface(image.surface);
+    }
+  }
+
   bool getTexture(const string path, shared_ptr<Texture>* texture) {
     PathToTextureMap::iterator it = textures->find(path);
     if (it == textures->end()) {
-      if (!renderer->loadTexture(path, texture)) {
+      string name = getBundleName(path);
+      const BundleImage* image = name.empty() ? NULL : bundle->findImage(name);
+
+      bool loaded;
+      if (image != NULL) {
+        loaded = loadBundledTexture(image, texture);
+      } else if (atlasEnabled) {
+        LOG("Loading texture: %s\n", path.c_str());
+        SDL_Surface* surface = IMG_Load(path.c_str());
+        loaded = surface != NULL && createTexture(surface, texture);
+        if (surface != NULL) {
+          SDL_FreeSurface(surface);
+        }
+      } else {
+        loaded = renderer->loadTexture(path, texture);
+      }
+
+      if (!loaded) {
         LOG("Error loading texture: %s\n", path.c_str());
         return false;
       }
@@ -55,7 +299,10 @@ class AssetManager {
   bool getFont(const string path, shared_ptr<Font>* font) {
     PathToFontMap::iterator it = fonts->find(path);
     if (it == fonts->end()) {
-      if (!loadFont(path, this, font)) {
+      string name = getBundleName(path);
+      const BundleFont* bundledFont = name.empty() ? NULL : bundle->findFont(name);
+
+      if (bundledFont != NULL ? !loadBundledFont(bundledFont, font) : !loadFont(path, this, font)) {
         LOG("Error loading font: %s\n", path.c_str());
         return false;
       }
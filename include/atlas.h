@@ -0,0 +1,185 @@
+#ifndef ATLAS_INCLUDED
+#define ATLAS_INCLUDED
+
+#include <SDL.h>
+#include <memory>
+#include <vector>
+#include "common.h"
+#include "render.h"
+
+using namespace std;
+
+const int ATLAS_PAGE_SIZE = 1024;
+
+// Images larger than this in either dimension get their own texture.
+const int ATLAS_MAX_ENTRY_SIZE = 256;
+
+// Transparent border kept around each entry so filtering never samples a
+// neighbour.
+const int ATLAS_PADDING = 1;
+
+// Packs rectangles into a fixed-size area using the skyline bottom-left
+// heuristic: the top edge of the packed area is kept as a list of
+// horizontal segments and each rectangle goes wherever it ends up lowest.
+class SkylinePacker {
+ private:
+  struct SkylineSegment {
+    int x;
+    int y;
+    int width;
+  };
+
+  int width;
+  int height;
+  vector<SkylineSegment> skyline;
+
+  // Returns the y a rect of the given size would rest at if its left edge
+  // were placed at segment index, or -1 if it does not fit there.
+  int fitAt(int index, int rectWidth, int rectHeight) const {
+    int x = skyline[index].x;
+    if (x + rectWidth > width) {
+      return -1;
+    }
+
+    int y = 0;
+    int remaining = rectWidth;
+    for (int i = index; remaining > 0; i++) {
+      y = max(y, skyline[i].y);
+      if (y + rectHeight > height) {
+        return -1;
+      }
+      remaining -= skyline[i].width;
+    }
+    return y;
+  }
+
+  void addSegment(int index, const SDL_Rect& rect) {
+    SkylineSegment segment = { rect.x, rect.y + rect.h, rect.w };
+    skyline.insert(skyline.begin() + index, segment);
+
+    // Trim or drop the segments now covered by the new one.
+    int right = rect.x + rect.w;
+    size_t i = index + 1;
+    while (i < skyline.size() && skyline[i].x < right) {
+      int covered = right - skyline[i].x;
+      skyline[i].x += covered;
+      skyline[i].width -= covered;
+      if (skyline[i].width > 0) {
+        break;
+      }
+      skyline.erase(skyline.begin() + i);
+    }
+
+    // Merge neighbours at the same height.
+    i = 0;
+    while (i + 1 < skyline.size()) {
+      if (skyline[i].y == skyline[i + 1].y) {
+        skyline[i].width += skyline[i + 1].width;
+        skyline.erase(skyline.begin() + i + 1);
+      } else {
+        i++;
+      }
+    }
+  }
+
+ public:
+  SkylinePacker(int width, int height) {
+    this->width = width;
+    this->height = height;
+    SkylineSegment segment = { 0, 0, width };
+    skyline.push_back(segment);
+  }
+
+  bool insert(int rectWidth, int rectHeight, SDL_Rect& rect) {
+    int bestIndex = -1;
+    int bestY = height;
+    int bestWidth = width + 1;
+
+    for (size_t i = 0; i < skyline.size(); i++) {
+      int y = fitAt(i, rectWidth, rectHeight);
+      if (y < 0) {
+        continue;
+      }
+
+      if (y + rectHeight < bestY ||
+          (y + rectHeight == bestY && skyline[i].width < bestWidth)) {
+        bestIndex = i;
+        bestY = y + rectHeight;
+        bestWidth = skyline[i].width;
+      }
+    }
+
+    if (bestIndex < 0) {
+      return false;
+    }
+
+    rect.x = skyline[bestIndex].x;
+    rect.y = bestY - rectHeight;
+    rect.w = rectWidth;
+    rect.h = rectHeight;
+
+    addSegment(bestIndex, rect);
+    return true;
+  }
+};
+
+struct AtlasPage {
+  shared_ptr<Texture> texture;
+  unique_ptr<SkylinePacker> packer;
+};
+
+// Packs small images into shared page textures so that sprites, tiles and
+// glyphs can be drawn in the same batch. Each image comes back as a Texture
+// referring to its region of a page.
+class TextureAtlas {
+ private:
+  vector<AtlasPage> pages;
+
+ public:
+  static bool accepts(const SDL_Surface* surface) {
+    return surface->w <= ATLAS_MAX_ENTRY_SIZE && surface->h <= ATLAS_MAX_ENTRY_SIZE;
+  }
+
+  bool add(const Renderer& renderer, SDL_Surface* surface, shared_ptr<Texture>* texture) {
+    int paddedWidth = surface->w + 2 * ATLAS_PADDING;
+    int paddedHeight = surface->h + 2 * ATLAS_PADDING;
+
+    SDL_Rect slot;
+    AtlasPage* page = NULL;
+    for (AtlasPage& candidate : pages) {
+      if (candidate.packer->insert(paddedWidth, paddedHeight, slot)) {
+        page = &candidate;
+        break;
+      }
+    }
+
+    if (page == NULL) {
+      AtlasPage newPage;
+      if (!renderer.createBlankTexture(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, &newPage.texture)) {
+        return false;
+      }
+      newPage.packer = unique_ptr<SkylinePacker>(new SkylinePacker(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE));
+      pages.push_back(move(newPage));
+
+      page = &pages.back();
+      if (!page->packer->insert(paddedWidth, paddedHeight, slot)) {
+        LOG("Image too large for atlas page: %dx%d\n", surface->w, surface->h);
+        return false;
+      }
+    }
+
+    SDL_Rect region = { slot.x + ATLAS_PADDING, slot.y + ATLAS_PADDING, surface->w, surface->h };
+    if (!renderer.updateTexture(*page->texture, region, surface)) {
+      return false;
+    }
+
+    *texture = shared_ptr<Texture>(new Texture(page->texture, region));
+    return true;
+  }
+
+  int getPageCount() const {
+    return (int) pages.size();
+  }
+};
+
+#endif
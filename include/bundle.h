@@ -0,0 +1,270 @@
+#ifndef BUNDLE_INCLUDED
+#define BUNDLE_INCLUDED
+
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "common.h"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Cooked asset bundle, written by the AssetCook tool and read by
+// AssetManager::loadBundle.
+//
+// Layout (all integers little endian, all offsets from the start of the
+// file, every record aligned to BUNDLE_ALIGNMENT):
+//
+//   BundleHeader
+//   record data, one block per entry
+//   string table (entry names and texture names, not NUL terminated)
+//   BundleEntry[entryCount]  <- header.tocOffset
+//
+// Images are stored as BundleImage followed by RGBA8888 pixels, so they can
+// be handed to SDL straight from the mapped file.
+
+const Uint32 BUNDLE_MAGIC = 0x4C444E42;  // "BNDL"
+const Uint32 BUNDLE_VERSION = 1;
+const Uint32 BUNDLE_ALIGNMENT = 16;
+
+enum BundleEntryType {
+  BUNDLE_IMAGE = 1,
+  BUNDLE_FONT,
+  BUNDLE_ANIMATION
+};
+
+struct BundleHeader {
+  Uint32 magic;
+  Uint32 version;
+  Uint32 entryCount;
+  Uint32 tocOffset;
+};
+
+struct BundleString {
+  Uint32 offset;
+  Uint32 length;
+};
+
+struct BundleEntry {
+  Uint32 type;
+  BundleString name;
+  Uint32 dataOffset;
+  Uint32 dataSize;
+};
+
+struct BundleImage {
+  Uint32 width;
+  Uint32 height;
+  Uint32 pitch;
+  Uint32 reserved;
+};
+
+struct BundleGlyph {
+  Sint32 offsetX;
+  Sint32 offsetY;
+  Sint32 advance;
+  Sint32 x;
+  Sint32 y;
+  Sint32 w;
+  Sint32 h;
+  Uint32 present;
+};
+
+struct BundleFont {
+  Sint32 height;
+  BundleString texture;
+  BundleGlyph glyphs[256];
+};
+
+struct BundleFrame {
+  Sint32 duration;
+  Sint32 x;
+  Sint32 y;
+  Sint32 w;
+  Sint32 h;
+};
+
+struct BundleAnimation {
+  BundleString texture;
+  Uint32 frameCount;
+  Uint32 reserved;
+  // BundleFrame[frameCount] follows.
+};
+
+// A bundle file mapped into memory. Records returned by the find functions
+// point into the mapping and stay valid for the lifetime of the bundle.
+class AssetBundle {
+ private:
+  const Uint8* data;
+  size_t size;
+  map<string, const BundleEntry*> entries;
+#ifdef _WIN32
+  vector<Uint8> contents;
+#endif
+
+  bool mapFile(const string& path) {
+#ifdef _WIN32
+    ifstream file(path.c_str(), ios::binary | ios::ate);
+    if (!file) {
+      return false;
+    }
+    contents.resize((size_t) file.tellg());
+    file.seekg(0);
+    file.read((char*) contents.data(), contents.size());
+    data = contents.data();
+    size = contents.size();
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+
+    void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+
+    data = (const Uint8*) mapping;
+    size = info.st_size;
+    return true;
+#endif
+  }
+
+  void unmapFile() {
+#ifndef _WIN32
+    if (data != NULL) {
+      munmap((void*) data, size);
+    }
+#endif
+    data = NULL;
+    size = 0;
+  }
+
+  bool inBounds(Uint32 offset, Uint32 length) const {
+    return offset <= size && length <= size - offset;
+  }
+
+ public:
+  AssetBundle() {
+    data = NULL;
+    size = 0;
+  }
+
+  ~AssetBundle() {
+    unmapFile();
+  }
+
+  bool open(const string& path) {
+    if (!mapFile(path)) {
+      LOG("Unable to map bundle: %s\n", path.c_str());
+      return false;
+    }
+
+    const BundleHeader* header = (const BundleHeader*) data;
+    if (size < sizeof(BundleHeader) || header->magic != BUNDLE_MAGIC ||
+        header->version != BUNDLE_VERSION ||
+        !inBounds(header->tocOffset, header->entryCount * sizeof(BundleEntry))) {
+      LOG("Invalid bundle: %s\n", path.c_str());
+      unmapFile();
+      return false;
+    }
+
+    const BundleEntry* toc = (const BundleEntry*) (data + header->tocOffset);
+    for (Uint32 i = 0; i < header->entryCount; i++) {
+      if (!inBounds(toc[i].dataOffset, toc[i].dataSize) ||
+          !inBounds(toc[i].name.offset, toc[i].name.length)) {
+        LOG("Corrupt bundle entry %u in %s\n", i, path.c_str());
+        continue;
+      }
+      entries[getString(toc[i].name)] = &toc[i];
+    }
+
+    LOG("Mapped bundle %s with %u entries\n", path.c_str(), header->entryCount);
+    return true;
+  }
+
+  bool isOpen() const {
+    return data != NULL;
+  }
+
+  string getString(const BundleString& value) const {
+    return string((const char*) data + value.offset, value.length);
+  }
+
+  const BundleEntry* find(const string& name, BundleEntryType type) const {
+    map<string, const BundleEntry*>::const_iterator it = entries.find(name);
+    if (it == entries.end() || it->second->type != (Uint32) type) {
+      return NULL;
+    }
+    return it->second;
+  }
+
+  const BundleImage* findImage(const string& name) const {
+    const BundleEntry* entry = find(name, BUNDLE_IMAGE);
+    if (entry == NULL || entry->dataSize < sizeof(BundleImage)) {
+      return NULL;
+    }
+
+    const BundleImage* image = (const BundleImage*) (data + entry->dataOffset);
+    if ((Uint64) image->pitch * image->height > entry->dataSize - sizeof(BundleImage)) {
+      return NULL;
+    }
+    return image;
+  }
+
+  const BundleFont* findFont(const string& name) const {
+    const BundleEntry* entry = find(name, BUNDLE_FONT);
+    if (entry == NULL || entry->dataSize < sizeof(BundleFont)) {
+      return NULL;
+    }
+    const BundleFont* font = (const BundleFont*) (data + entry->dataOffset);
+    if (!inBounds(font->texture.offset, font->texture.length)) {
+      return NULL;
+    }
+    return font;
+  }
+
+  const BundleAnimation* findAnimation(const string& name) const {
+    const BundleEntry* entry = find(name, BUNDLE_ANIMATION);
+    if (entry == NULL || entry->dataSize < sizeof(BundleAnimation)) {
+      return NULL;
+    }
+
+    const BundleAnimation* animation = (const BundleAnimation*) (data + entry->dataOffset);
+    if ((Uint64) animation->frameCount * sizeof(BundleFrame) >
+        entry->dataSize - sizeof(BundleAnimation) ||
+        !inBounds(animation->texture.offset, animation->texture.length)) {
+      return NULL;
+    }
+    return animation;
+  }
+
+  static const void* getPixels(const BundleImage* image) {
+    return image + 1;
+  }
+
+  static const BundleFrame* getFrames(const BundleAnimation* animation) {
+    return (const BundleFrame*) (animation + 1);
+  }
+};
+
+#endif
@@ -14,5 +14,10 @@ const int SCREEN_HEIGHT = 480;
 const float B2_UNITS_TO_PIXELS = 100.0f;
 const float PIXELS_TO_B2_UNITS = 1.0f / B2_UNITS_TO_PIXELS;
 
+// Simulation settings shared by the game loop and the headless benchmarks.
+const float PHYSICS_TIME_STEP = 1.0f / 60.0f;
+const int PHYSICS_VELOCITY_ITERATIONS = 6;
+const int PHYSICS_POSITION_ITERATIONS = 2;
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+#ifndef COMPONENTS_INCLUDED
+#define COMPONENTS_INCLUDED
+
+#include <SDL.h>
+#include "animation.h"
+#include "common.h"
+#include "ecs.h"
+#include "render.h"
+#include "Box2D/Box2D.h"
+
+using namespace std;
+
+class Vector {
+ private:
+
+ public:
+ 	float x;
+ 	float y;
+
+  Vector() : Vector(0.0f, 0.0f) {}
+
+  Vector (float x, float y) {
+  	this->x = x;
+  	this->y = y;
+  }
+
+  float getX() {
+  	return x;
+  }
+
+  float getY() {
+  	return y;
+  }
+};
+
+// Position is in pixels and refers to the centre of the entity.
+class Transform {
+ private:
+  Vector position;
+  float rotation;
+  float scale;
+
+ public:
+  Transform() {
+    position = Vector();
+    rotation = 0.0f;
+    scale = 1.0f;
+  }
+
+  Vector getPosition() const { return position; }
+
+  void setPosition(Vector position) { this->position = position; }
+
+  float getRotation() const { return rotation; }
+
+  void setRotation(float rotation) { this->rotation = rotation; }
+
+  float getScale() const { return scale; }
+
+  void setScale(float scale) { this->scale = scale; }
+};
+
+// The texture is owned by the AssetManager and must outlive the entity.
+struct SpriteComponent {
+  const Texture* texture;
+  SDL_Rect source;
+  int width;
+  int height;
+};
+
+// Links an entity to its Box2D body. The body's position before and after
+// the latest physics step is kept for render interpolation.
+struct BodyComponent {
+  b2Body* body;
+  b2Vec2 previousPosition;
+  b2Vec2 currentPosition;
+};
+
+struct AnimationComponent {
+  AnimationInstanceId instance;
+};
+
+// Call before each physics step.
+void storePreviousBodyPositions(EntityManager& entities) {
+  entities.eachChunk<BodyComponent>([](int count, const Entity*, BodyComponent* bodies) {
+    for (int i = 0; i < count; i++) {
+      bodies[i].previousPosition = bodies[i].currentPosition;
+    }
+  });
+}
+
+// Call after each physics step.
+void storeCurrentBodyPositions(EntityManager& entities) {
+  entities.eachChunk<BodyComponent>([](int count, const Entity*, BodyComponent* bodies) {
+    for (int i = 0; i < count; i++) {
+      bodies[i].currentPosition = bodies[i].body->GetPosition();
+    }
+  });
+}
+
+// Moves transforms to the body positions interpolated by alpha, where 0 is
+// the state before the latest step and 1 the state after it.
+void interpolateBodyTransforms(EntityManager& entities, float alpha) {
+  entities.each<Transform, BodyComponent>([alpha](Entity, Transform& transform, BodyComponent& body) {
+    b2Vec2 position = (1.0f - alpha) * body.previousPosition + alpha * body.currentPosition;
+    transform.setPosition(Vector(position.x * B2_UNITS_TO_PIXELS, -position.y * B2_UNITS_TO_PIXELS));
+  });
+}
+
+// Points each animated sprite at its current animation frame.
+void updateAnimatedSprites(EntityManager& entities, const AnimationSystem& animations) {
+  entities.each<SpriteComponent, AnimationComponent>(
+      [&animations](Entity, SpriteComponent& sprite, AnimationComponent& animation) {
+    sprite.source = animations.getFrame(animation.instance);
+  });
+}
+
+void renderSprites(EntityManager& entities, Renderer& renderer) {
+  entities.each<Transform, SpriteComponent>([&renderer](Entity, Transform& transform, SpriteComponent& sprite) {
+    Vector position = transform.getPosition();
+    int width = (int) (sprite.width * transform.getScale());
+    int height = (int) (sprite.height * transform.getScale());
+    SDL_Rect destination = { (int) position.x - width / 2, (int) position.y - height / 2, width, height };
+    renderer.render(*sprite.texture, &sprite.source, &destination);
+  });
+}
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef ECS_INCLUDED
+#define ECS_INCLUDED
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "common.h"
+
+using namespace std;
+
+// Entities with archetype storage: every entity with the same set of
+// component types lives in the same Archetype, which keeps one tightly
+// packed array per component type. Queries walk the matching archetypes
+// and hand out those arrays, so iterating a component touches memory in
+// order.
+//
+// Components are plain data. They are moved between archetypes with
+// memcpy, so they must be trivially copyable; anything owned (textures,
+// bodies) is held by pointer and owned elsewhere.
+
+typedef int ComponentTypeId;
+typedef Uint32 ComponentMask;
+
+const int MAX_COMPONENT_TYPES = 32;
+
+// Cheap handle to an entity. The generation is bumped whenever an index is
+// reused, so a handle to a destroyed entity never matches its successor.
+struct Entity {
+  Uint32 index;
+  Uint32 generation;
+};
+
+inline vector<size_t>& getComponentSizes() {
+  static vector<size_t> sizes;
+  return sizes;
+}
+
+template <typename T>
+ComponentTypeId getComponentTypeId() {
+  static_assert(is_trivially_copyable<T>::value, "Components must be trivially copyable");
+  static ComponentTypeId id = -1;
+  if (id < 0) {
+    vector<size_t>& sizes = getComponentSizes();
+    if (sizes.size() >= MAX_COMPONENT_TYPES) {
+      LOG("Too many component types, limit is %d\n", MAX_COMPONENT_TYPES);
+      abort();
+    }
+    id = (ComponentTypeId) sizes.size();
+    sizes.push_back(sizeof(T));
+  }
+  return id;
+}
+
+template <typename... Components>
+ComponentMask getComponentMask() {
+  ComponentMask bits[] = { 0u, (1u << getComponentTypeId<Components>())... };
+  ComponentMask mask = 0;
+  for (ComponentMask bit : bits) {
+    mask |= bit;
+  }
+  return mask;
+}
+
+class Archetype {
+ private:
+  struct Column {
+    ComponentTypeId type;
+    size_t size;
+    vector<Uint8> data;
+  };
+
+  ComponentMask mask;
+  vector<Column> columns;
+  int columnIndex[MAX_COMPONENT_TYPES];
+  vector<Entity> entities;
+
+ public:
+  Archetype(ComponentMask mask) {
+    this->mask = mask;
+    const vector<size_t>& sizes = getComponentSizes();
+    for (int type = 0; type < MAX_COMPONENT_TYPES; type++) {
+      columnIndex[type] = -1;
+      if (mask & (1u << type)) {
+        columnIndex[type] = (int) columns.size();
+        Column column = { type, sizes[type], vector<Uint8>() };
+        columns.push_back(column);
+      }
+    }
+  }
+
+  ComponentMask getMask() const {
+    return mask;
+  }
+
+  int getCount() const {
+    return (int) entities.size();
+  }
+
+  const Entity* getEntities() const {
+    return entities.data();
+  }
+
+  template <typename T>
+  T* getColumn() {
+    int index = columnIndex[getComponentTypeId<T>()];
+    return index < 0 ? NULL : (T*) columns[index].data.data();
+  }
+
+  void* getComponent(ComponentTypeId type, int row) {
+    Column& column = columns[columnIndex[type]];
+    return column.data.data() + row * column.size;
+  }
+
+  // Appends a row with uninitialized components and returns its index.
+  int addRow(Entity entity) {
+    for (Column& column : columns) {
+      column.data.resize(column.data.size() + column.size);
+    }
+    entities.push_back(entity);
+    return (int) entities.size() - 1;
+  }
+
+  // Copies the components both archetypes share from row of source into
+  // row of this archetype.
+  void copyRow(int row, Archetype& source, int sourceRow) {
+    for (Column& column : columns) {
+      if (source.mask & (1u << column.type)) {
+        memcpy(column.data.data() + row * column.size,
+               source.getComponent(column.type, sourceRow), column.size);
+      }
+    }
+  }
+
+  // Removes row by moving the last row into it. Returns the entity that
+  // was moved, or the removed entity if it was the last row.
+  Entity removeRow(int row) {
+    int last = (int) entities.size() - 1;
+    if (row != last) {
+      for (Column& column : columns) {
+        memcpy(column.data.data() + row * column.size,
+               column.data.data() + last * column.size, column.size);
+      }
+      entities[row] = entities[last];
+    }
+
+    Entity moved = entities[row];
+    for (Column& column : columns) {
+      column.data.resize(column.data.size() - column.size);
+    }
+    entities.pop_back();
+    return moved;
+  }
+};
+
+typedef map<ComponentMask, int> ComponentMaskToArchetypeMap;
+
+class EntityManager {
+ private:
+  struct EntityLocation {
+    Uint32 generation;
+    int archetype;
+    int row;
+  };
+
+  vector<unique_ptr<Archetype>> archetypes;
+  ComponentMaskToArchetypeMap archetypeIndex;
+  vector<EntityLocation> locations;
+  vector<Uint32> freeIndices;
+
+  int getArchetype(ComponentMask mask) {
+    ComponentMaskToArchetypeMap::iterator it = archetypeIndex.find(mask);
+    if (it != archetypeIndex.end()) {
+      return it->second;
+    }
+
+    archetypes.push_back(unique_ptr<Archetype>(new Archetype(mask)));
+    int index = (int) archetypes.size() - 1;
+    archetypeIndex[mask] = index;
+    return index;
+  }
+
+  void removeFromArchetype(EntityLocation& location) {
+    Entity moved = archetypes[location.archetype]->removeRow(location.row);
+    locations[moved.index].row = location.row;
+  }
+
+  // Moves entity into the archetype for mask, keeping the components the
+  // two archetypes share.
+  void moveEntity(Entity entity, ComponentMask mask) {
+    EntityLocation& location = locations[entity.index];
+    int target = getArchetype(mask);
+    if (target == location.archetype) {
+      return;
+    }
+
+    int row = archetypes[target]->addRow(entity);
+    archetypes[target]->copyRow(row, *archetypes[location.archetype], location.row);
+    removeFromArchetype(location);
+
+    location.archetype = target;
+    location.row = row;
+  }
+
+  template <typename F, typename... Components>
+  static void eachRow(F& function, int count, const Entity* entities, Components*... columns) {
+    for (int row = 0; row < count; row++) {
+      function(entities[row], columns[row]...);
+    }
+  }
+
+ public:
+  EntityManager() {
+    getArchetype(0);
+  }
+
+  Entity create() {
+    Entity entity;
+    if (freeIndices.empty()) {
+      entity.index = (Uint32) locations.size();
+      entity.generation = 0;
+      EntityLocation location = { 0, 0, 0 };
+      locations.push_back(location);
+    } else {
+      entity.index = freeIndices.back();
+      entity.generation = locations[entity.index].generation;
+      freeIndices.pop_back();
+    }
+
+    EntityLocation& location = locations[entity.index];
+    location.archetype = 0;
+    location.row = archetypes[0]->addRow(entity);
+    return entity;
+  }
+
+  bool isAlive(Entity entity) const {
+    return entity.index < locations.size() &&
+           locations[entity.index].generation == entity.generation &&
+           locations[entity.index].archetype >= 0;
+  }
+
+  void destroy(Entity entity) {
+    if (!isAlive(entity)) {
+      return;
+    }
+
+    EntityLocation& location = locations[entity.index];
+    removeFromArchetype(location);
+    location.generation++;
+    location.archetype = -1;
+    freeIndices.push_back(entity.index);
+  }
+
+  template <typename T>
+  bool has(Entity entity) const {
+    return isAlive(entity) &&
+           (archetypes[locations[entity.index].archetype]->getMask() & getComponentMask<T>()) != 0;
+  }
+
+  // Adds component to entity, or overwrites it if the entity already has one.
+  template <typename T>
+  void add(Entity entity, const T& component) {
+    if (!isAlive(entity)) {
+      LOG("Adding component to dead entity %u\n", entity.index);
+      return;
+    }
+
+    ComponentMask mask = archetypes[locations[entity.index].archetype]->getMask();
+    moveEntity(entity, mask | getComponentMask<T>());
+    *get<T>(entity) = component;
+  }
+
+  template <typename T>
+  void remove(Entity entity) {
+    if (!isAlive(entity)) {
+      return;
+    }
+
+    ComponentMask mask = archetypes[locations[entity.index].archetype]->getMask();
+    moveEntity(entity, mask & ~getComponentMask<T>());
+  }
+
+  // Returns NULL if the entity is dead or lacks the component. The pointer
+  // is invalidated by any add, remove, create or destroy.
+  template <typename T>
+  T* get(Entity entity) {
+    if (!isAlive(entity)) {
+      return NULL;
+    }
+
+    const EntityLocation& location = locations[entity.index];
+    T* column = archetypes[location.archetype]->getColumn<T>();
+    return column == NULL ? NULL : column + location.row;
+  }
+
+  // Calls function(count, entities, columns...) once per archetype that has
+  // all of Components, with one pointer per component array.
+  template <typename... Components, typename F>
+  void eachChunk(F function) {
+    ComponentMask mask = getComponentMask<Components...>();
+    for (unique_ptr<Archetype>& archetype : archetypes) {
+      if ((archetype->getMask() & mask) == mask && archetype->getCount() > 0) {
+        function(archetype->getCount(), archetype->getEntities(),
+                 archetype->template getColumn<Components>()...);
+      }
+    }
+  }
+
+  // Calls function(entity, components&...) for every entity that has all of
+  // Components. Entities must not be created, destroyed or change
+  // components from inside the callback.
+  template <typename... Components, typename F>
+  void each(F function) {
+    ComponentMask mask = getComponentMask<Components...>();
+    for (unique_ptr<Archetype>& archetype : archetypes) {
+      if ((archetype->getMask() & mask) == mask && archetype->getCount() > 0) {
+        eachRow(function, archetype->getCount(), archetype->getEntities(),
+                archetype->template getColumn<Components>()...);
+      }
+    }
+  }
+};
+
+#endif
@@ -6,8 +6,9 @@
 #include <SDL_image.h>
 #include <string>
 #include "tinyxml2.h"
+#include <algorithm>
 #include <memory>
-#include <map>
+#include <vector>
 #include "common.h"
 #include "render.h"
 #include "assets.h"
@@ -15,147 +16,216 @@
 using namespace std;
 using namespace tinyxml2;
 
-class Glyph;
+// Glyphs are looked up by byte value, which covers the ASCII fonts we ship.
+const int GLYPH_TABLE_SIZE = 256;
 
-
-typedef map<string, shared_ptr<Glyph> > StringToSharedGlyphPtrMap;
-typedef pair<string, shared_ptr<Glyph> > StringToSharedGlyphPtrPair;
-
-class Glyph {
-private:
+struct Glyph {
 	int offsetX;
 	int offsetY;
 	int advance;
-	std::shared_ptr<SDL_Rect> rect;
-	shared_ptr<string> value;
-
-public: 
-	Glyph(int offsetX, int offsetY, int advance,
-		std::shared_ptr<SDL_Rect> rect, shared_ptr<string> value) {
-		this->offsetX = offsetX;
-		this->offsetY = offsetY;
-		this->advance = advance;
-		this->rect = rect;
-		this->value = value;
-	}
+	SDL_Rect rect;
+	bool present;
+};
 
-	shared_ptr<SDL_Rect> getRect() {
-		return rect;
-	}
+class Font;
 
-	int getOffsetX() {
-		return offsetX;
-	}
+// Text laid out into quads relative to its origin. Keep one around for
+// text that rarely changes, such as the FPS counter, and call setText every
+// frame: the quads are only rebuilt when the text actually changes.
+class TextRun {
+private:
+	const Font* font;
+	string text;
+	vector<SDL_Rect> sources;
+	vector<SDL_Rect> destinations;
+
+	friend class Font;
 
-	int getOffsetY() {
-		return offsetY;
+public:
+	TextRun() {
+		font = NULL;
 	}
 
-	int getAdvance() {
-		return advance;
+	void setText(const Font& font, const string& text);
+
+	const string& getText() const {
+		return text;
 	}
 };
 
 class Font {
 private:
-	unique_ptr<StringToSharedGlyphPtrMap> glyphMap;
+	Glyph glyphs[GLYPH_TABLE_SIZE];
 	shared_ptr<Texture> texture;
 	int height;
 
+	const Glyph& getGlyph(char c) const {
+		return glyphs[(unsigned char) c];
+	}
+
 public:
-	Font(unique_ptr<StringToSharedGlyphPtrMap> glyphMap, shared_ptr<Texture> texture, int height) {
-		this->glyphMap = std::move(glyphMap);
+	// glyphTable must hold GLYPH_TABLE_SIZE entries indexed by character.
+	Font(const Glyph* glyphTable, shared_ptr<Texture> texture, int height) {
+		copy(glyphTable, glyphTable + GLYPH_TABLE_SIZE, glyphs);
 		this->texture = texture;
 		this->height = height;
 	}
 
-	void render(const Renderer& renderer, const string& text, int x, int y) {
-		y += height / 2;
-		for (int i = 0; i < text.size(); i++) {
-			string key = string(1, text.at(i));
-			shared_ptr<Glyph> glyph = glyphMap->at(key);
-			
-			shared_ptr<SDL_Rect> source = glyph->getRect();
-			SDL_Rect destination = { x + glyph->getOffsetX(), y - glyph->getOffsetY(), source->w, source->h };
-			
-			renderer.render(*texture, source.get(), &destination);
-
-			x += glyph->getAdvance();
+	int getHeight() const {
+		return height;
+	}
+
+	// Fills run with one quad per visible character of text, positioned
+	// relative to the origin passed to render.
+	void layout(const string& text, TextRun& run) const {
+		run.font = this;
+		run.text = text;
+		run.sources.clear();
+		run.destinations.clear();
+
+		int x = 0;
+		int y = height / 2;
+		for (size_t i = 0; i < text.size(); i++) {
+			const Glyph& glyph = getGlyph(text[i]);
+			if (!glyph.present) {
+				continue;
+			}
+
+			if (glyph.rect.w > 0 && glyph.rect.h > 0) {
+				SDL_Rect destination = { x + glyph.offsetX, y - glyph.offsetY, glyph.rect.w, glyph.rect.h };
+				run.sources.push_back(glyph.rect);
+				run.destinations.push_back(destination);
+			}
+
+			x += glyph.advance;
 		}
 	}
-};
 
-bool loadFont(string path, AssetManager* assetManager, shared_ptr<Font>* font) {
+	// The quads are glyph rects of the font that laid the run out, so they
+	// are drawn from that font's texture, which need not be this one's.
+	void render(Renderer& renderer, const TextRun& run, int x, int y) {
+		for (size_t i = 0; i < run.sources.size(); i++) {
+			SDL_Rect source = run.sources[i];
+			SDL_Rect destination = run.destinations[i];
+			destination.x += x;
+			destination.y += y;
 
-	LOG("Loading Font: %s\n", path.c_str());
-	string texPath = path;
-	texPath += ".png";
+			renderer.render(*run.font->texture, &source, &destination);
+		}
+	}
 
-	shared_ptr<Texture> texture = shared_ptr<Texture>(NULL);
-	if (!assetManager->getTexture(texPath, &texture)) {
-		LOG("Unable to load font texture!\n");
-		return false;		
+	void render(Renderer& renderer, const string& text, int x, int y) {
+		y += height / 2;
+		for (size_t i = 0; i < text.size(); i++) {
+			const Glyph& glyph = getGlyph(text[i]);
+			if (!glyph.present) {
+				continue;
+			}
+
+			if (glyph.rect.w > 0 && glyph.rect.h > 0) {
+				SDL_Rect source = glyph.rect;
+				SDL_Rect destination = { x + glyph.offsetX, y - glyph.offsetY, source.w, source.h };
+
+				renderer.render(*texture, &source, &destination);
+			}
+
+			x += glyph.advance;
+		}
 	}
+};
 
-	path += ".xml";
+inline void TextRun::setText(const Font& font, const string& text) {
+	if (this->font == &font && this->text == text) {
+		return;
+	}
+
+	font.layout(text, *this);
+}
+
+// Reads glyph metrics from a font description exported as XML. textureFile
+// receives the file name of the glyph page the XML refers to.
+bool parseFontXml(const string& path, Glyph* glyphs, int* height, string* textureFile) {
 	XMLDocument doc;
 	doc.LoadFile(path.c_str());
 	XMLNode* fontNode = doc.FirstChildElement("font");
 	if (!fontNode) {
 		return false;
 	}
-	int height;
-	fontNode->FirstChildElement("metrics")->QueryIntAttribute("height", &height);
+	fontNode->FirstChildElement("metrics")->QueryIntAttribute("height", height);
 
+	XMLElement* textureNode = fontNode->FirstChildElement("texture");
+	const char* file = textureNode == NULL ? NULL : textureNode->Attribute("file");
+	*textureFile = file == NULL ? "" : file;
 
 	XMLNode* charNode = 
 		fontNode->FirstChildElement("chars")->FirstChild();
 
 	XMLElement* element;
 
-	unique_ptr<StringToSharedGlyphPtrMap> valueToGlyphMap = unique_ptr<StringToSharedGlyphPtrMap>(new StringToSharedGlyphPtrMap());
-	const char* tmpValue = "Temp Value";
-	StringToSharedGlyphPtrPair pair;
+	fill(glyphs, glyphs + GLYPH_TABLE_SIZE, Glyph());
+	const char* value = "";
 	while (charNode) {
 		element = charNode->ToElement();
 		
-		int offsetX;
-		int offsetY;
-		int advance;
-		int rectX;
-		int rectY;
-		int rectW;
-		int rectH;
-		element->QueryIntAttribute("advance", &advance);
-		element->QueryIntAttribute("offset_x", &offsetX);
-		element->QueryIntAttribute("offset_y", &offsetY);
-		element->QueryIntAttribute("rect_x", &rectX);
-		element->QueryIntAttribute("rect_y", &rectY);
-		element->QueryIntAttribute("rect_w", &rectW);
-		element->QueryIntAttribute("rect_h", &rectH);
-		element->QueryStringAttribute("id", &tmpValue);
-
-		string value = string(tmpValue);
-
-		SDL_Rect* rect = new SDL_Rect;
-		rect->x = rectX;
-		rect->y = rectY;
-		rect->w = rectW;
-		rect->h = rectH;
-
-		std::shared_ptr <Glyph> glyph = shared_ptr<Glyph>(new Glyph(offsetX, offsetY, advance,
-			shared_ptr<SDL_Rect>(rect),
-			shared_ptr<string>(new string(value.c_str()))));
-
-		pair.first = value;
-		pair.second = glyph;
-
-		valueToGlyphMap->insert(pair);
+		Glyph glyph = {};
+		element->QueryIntAttribute("advance", &glyph.advance);
+		element->QueryIntAttribute("offset_x", &glyph.offsetX);
+		element->QueryIntAttribute("offset_y", &glyph.offsetY);
+		element->QueryIntAttribute("rect_x", &glyph.rect.x);
+		element->QueryIntAttribute("rect_y", &glyph.rect.y);
+		element->QueryIntAttribute("rect_w", &glyph.rect.w);
+		element->QueryIntAttribute("rect_h", &glyph.rect.h);
+		element->QueryStringAttribute("id", &value);
+
+		if (value[0] == '\0' || value[1] != '\0') {
+			LOG("Skipping glyph that is not a single byte: %s\n", value);
+		} else {
+			glyph.present = true;
+			glyphs[(unsigned char) value[0]] = glyph;
+		}
 
 		charNode = charNode->NextSibling();
 	}
+
+	return true;
+}
+
+bool createBundledFont(const BundleFont& bundledFont, shared_ptr<Texture> texture, shared_ptr<Font>* font) {
+	Glyph glyphs[GLYPH_TABLE_SIZE];
+	for (int i = 0; i < GLYPH_TABLE_SIZE; i++) {
+		const BundleGlyph& source = bundledFont.glyphs[i];
+		glyphs[i].offsetX = source.offsetX;
+		glyphs[i].offsetY = source.offsetY;
+		glyphs[i].advance = source.advance;
+		glyphs[i].rect = { source.x, source.y, source.w, source.h };
+		glyphs[i].present = source.present != 0;
+	}
+
+	*font = shared_ptr<Font>(new Font(glyphs, texture, bundledFont.height));
+	return true;
+}
+
+bool loadFont(string path, AssetManager* assetManager, shared_ptr<Font>* font) {
+
+	LOG("Loading Font: %s\n", path.c_str());
+	string texPath = path;
+	texPath += ".png";
+
+	shared_ptr<Texture> texture = shared_ptr<Texture>(NULL);
+	if (!assetManager->getTexture(texPath, &texture)) {
+		LOG("Unable to load font texture!\n");
+		return false;		
+	}
+
+	path += ".xml";
+	Glyph glyphs[GLYPH_TABLE_SIZE];
+	int height;
+	string textureFile;
+	if (!parseFontXml(path, glyphs, &height, &textureFile)) {
+		return false;
+	}
 	
-	*font = shared_ptr<Font>(new Font(std::move(valueToGlyphMap), texture, height));
+	*font = shared_ptr<Font>(new Font(glyphs, texture, height));
 	return true;
 }
 
@@ -0,0 +1,251 @@
+#ifndef JOBS_INCLUDED
+#define JOBS_INCLUDED
+
+#include <SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "common.h"
+
+using namespace std;
+
+typedef function<void()> Job;
+
+// Counts outstanding jobs. Pass one to schedule() and wait on it to know
+// when all of those jobs have finished. A job that depends on others waits
+// on their counter; the wait runs other jobs in the meantime instead of
+// blocking the thread.
+class JobCounter {
+ private:
+  atomic<int> pending;
+
+ public:
+  JobCounter() : pending(0) {}
+
+  void increment(int count) {
+    pending.fetch_add(count);
+  }
+
+  void decrement() {
+    pending.fetch_sub(1);
+  }
+
+  bool isDone() const {
+    return pending.load() == 0;
+  }
+};
+
+struct QueuedJob {
+  Job job;
+  JobCounter* counter;
+};
+
+// Work-stealing scheduler. Each thread has its own deque; jobs scheduled
+// from a thread go on that thread's deque, the owner takes from the back,
+// and idle threads steal from the front of the others.
+//
+// The thread that constructs the JobSystem is the main thread and counts as
+// worker 0. It only runs jobs while waiting on a counter or pumping. Jobs
+// that must call SDL (rendering, texture uploads, events) go through
+// scheduleOnMainThread() and are only ever run by the main thread.
+class JobSystem {
+ private:
+  struct WorkerQueue {
+    mutex queueMutex;
+    deque<QueuedJob> jobs;
+  };
+
+  vector<unique_ptr<WorkerQueue>> queues;
+  vector<thread> workers;
+
+  mutex mainThreadMutex;
+  deque<QueuedJob> mainThreadJobs;
+
+  // Lets idle workers sleep instead of spinning. queuedJobs counts jobs in
+  // the worker deques only.
+  mutex sleepMutex;
+  condition_variable jobAvailable;
+  atomic<int> queuedJobs;
+  atomic<bool> stopping;
+
+  static int& currentWorker() {
+    static thread_local int worker = -1;
+    return worker;
+  }
+
+  void push(WorkerQueue& queue, QueuedJob& queued) {
+    {
+      lock_guard<mutex> lock(queue.queueMutex);
+      queue.jobs.push_back(move(queued));
+    }
+    queuedJobs.fetch_add(1);
+    jobAvailable.notify_one();
+  }
+
+  bool popOwn(int worker, QueuedJob& queued) {
+    WorkerQueue& queue = *queues[worker];
+    lock_guard<mutex> lock(queue.queueMutex);
+    if (queue.jobs.empty()) {
+      return false;
+    }
+    queued = move(queue.jobs.back());
+    queue.jobs.pop_back();
+    return true;
+  }
+
+  bool steal(int worker, QueuedJob& queued) {
+    int count = (int) queues.size();
+    for (int i = 1; i < count; i++) {
+      WorkerQueue& queue = *queues[(worker + i) % count];
+      lock_guard<mutex> lock(queue.queueMutex);
+      if (!queue.jobs.empty()) {
+        queued = move(queue.jobs.front());
+        queue.jobs.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool popMainThread(QueuedJob& queued) {
+    lock_guard<mutex> lock(mainThreadMutex);
+    if (mainThreadJobs.empty()) {
+      return false;
+    }
+    queued = move(mainThreadJobs.front());
+    mainThreadJobs.pop_front();
+    return true;
+  }
+
+  void run(QueuedJob& queued) {
+    queued.job();
+    if (queued.counter != NULL) {
+      queued.counter->decrement();
+    }
+  }
+
+  // Runs one job if any is available to the calling thread.
+  bool runOne() {
+    int worker = currentWorker();
+    QueuedJob queued;
+    if (worker == 0 && popMainThread(queued)) {
+      run(queued);
+      return true;
+    }
+
+    if (popOwn(max(worker, 0), queued) || steal(max(worker, 0), queued)) {
+      queuedJobs.fetch_sub(1);
+      run(queued);
+      return true;
+    }
+    return false;
+  }
+
+  void work(int worker) {
+    currentWorker() = worker;
+    while (!stopping.load()) {
+      if (runOne()) {
+        continue;
+      }
+
+      // The timeout covers the race between checking the queues and
+      // starting to wait.
+      unique_lock<mutex> lock(sleepMutex);
+      jobAvailable.wait_for(lock, chrono::milliseconds(1), [this] {
+        return stopping.load() || queuedJobs.load() > 0;
+      });
+    }
+  }
+
+ public:
+  // workerCount is the number of threads in addition to the main thread.
+  JobSystem(int workerCount) : queuedJobs(0), stopping(false) {
+    currentWorker() = 0;
+    for (int i = 0; i <= workerCount; i++) {
+      queues.push_back(unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+    for (int i = 1; i <= workerCount; i++) {
+      workers.push_back(thread(&JobSystem::work, this, i));
+    }
+  }
+
+  ~JobSystem() {
+    stopping.store(true);
+    jobAvailable.notify_all();
+    for (thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+  // Worker count that leaves one core for the main thread.
+  static int getDefaultWorkerCount() {
+    return max(SDL_GetCPUCount() - 1, 1);
+  }
+
+  int getThreadCount() const {
+    return (int) queues.size();
+  }
+
+  // Index of the calling thread: 0 for the main thread, 1 and up for
+  // workers, -1 for threads the JobSystem does not own.
+  static int getCurrentWorker() {
+    return currentWorker();
+  }
+
+  void schedule(Job job, JobCounter* counter = NULL) {
+    if (counter != NULL) {
+      counter->increment(1);
+    }
+
+    int worker = currentWorker();
+    QueuedJob queued = { move(job), counter };
+    push(*queues[worker < 0 ? 0 : worker], queued);
+  }
+
+  void scheduleOnMainThread(Job job, JobCounter* counter = NULL) {
+    if (counter != NULL) {
+      counter->increment(1);
+    }
+
+    QueuedJob queued = { move(job), counter };
+    lock_guard<mutex> lock(mainThreadMutex);
+    mainThreadJobs.push_back(move(queued));
+  }
+
+  // Splits [0, count) into ranges of at most grainSize and runs
+  // body(begin, end) on each as a separate job.
+  void parallelFor(int count, int grainSize, function<void(int, int)> body, JobCounter* counter) {
+    for (int begin = 0; begin < count; begin += grainSize) {
+      int end = min(begin + grainSize, count);
+      schedule([body, begin, end] { body(begin, end); }, counter);
+    }
+  }
+
+  // Runs jobs until counter reaches zero. On the main thread this includes
+  // main-thread jobs.
+  void wait(const JobCounter& counter) {
+    while (!counter.isDone()) {
+      if (!runOne()) {
+        this_thread::yield();
+      }
+    }
+  }
+
+  // Runs any queued main-thread jobs. Call once per frame from the main
+  // thread.
+  void pumpMainThread() {
+    QueuedJob queued;
+    while (popMainThread(queued)) {
+      run(queued);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef JSONREADER_INCLUDED
+#define JSONREADER_INCLUDED
+
+#include <stdlib.h>
+#include <string>
+
+using namespace std;
+
+// Pull parser over a NUL-terminated JSON buffer. Values are read in document
+// order straight out of the buffer; nothing is built up for the parts the
+// caller skips. Every read returns false on malformed input.
+//
+// Objects are walked with:
+//
+//   if (!reader.beginObject()) return false;
+//   while (reader.nextKey(key)) { ...read or skip the value... }
+//   if (!reader.ok()) return false;
+//
+// and arrays the same way with beginArray()/nextElement(). finish() checks
+// that nothing but whitespace follows the top-level value.
+class JsonReader {
+ private:
+  const char* position;
+  const char* end;
+  bool failed;
+
+  // Set after beginObject/beginArray so the first nextKey/nextElement does
+  // not expect a comma.
+  bool first;
+
+  void skipWhitespace() {
+    while (position < end && (*position == ' ' || *position == '\n' ||
+                              *position == '\r' || *position == '\t')) {
+      position++;
+    }
+  }
+
+  bool fail() {
+    failed = true;
+    return false;
+  }
+
+  bool expect(char c) {
+    skipWhitespace();
+    if (position >= end || *position != c) {
+      return fail();
+    }
+    position++;
+    return true;
+  }
+
+  bool skipLiteral(const char* literal) {
+    for (; *literal != '\0'; literal++, position++) {
+      if (position >= end || *position != *literal) {
+        return fail();
+      }
+    }
+    return true;
+  }
+
+  // Moves past the closing bracket, or past the comma before the next item.
+  // Returns false at the end of the container.
+  bool next(char close) {
+    skipWhitespace();
+    if (position < end && *position == close) {
+      position++;
+      first = false;
+      return false;
+    }
+
+    if (!first && !expect(',')) {
+      return false;
+    }
+    first = false;
+    return true;
+  }
+
+ public:
+  JsonReader(const char* text, size_t length) {
+    position = text;
+    end = text + length;
+    failed = false;
+    first = false;
+  }
+
+  bool ok() const {
+    return !failed;
+  }
+
+  // Call after the top-level value. Fails unless only whitespace is left.
+  bool finish() {
+    skipWhitespace();
+    if (position != end) {
+      return fail();
+    }
+    return ok();
+  }
+
+  bool beginObject() {
+    first = true;
+    return expect('{');
+  }
+
+  bool beginArray() {
+    first = true;
+    return expect('[');
+  }
+
+  bool isObject() {
+    skipWhitespace();
+    return position < end && *position == '{';
+  }
+
+  bool isArray() {
+    skipWhitespace();
+    return position < end && *position == '[';
+  }
+
+  // Reads the next key and its colon. Returns false at the closing brace or
+  // on error; check ok() to tell them apart.
+  bool nextKey(string& key) {
+    return next('}') && readString(key) && expect(':');
+  }
+
+  bool nextElement() {
+    if (!next(']')) {
+      return false;
+    }
+
+    // Catch a trailing comma before the caller tries to read a value.
+    skipWhitespace();
+    if (position < end && *position == ']') {
+      return fail();
+    }
+    return true;
+  }
+
+  // Moves past a string without copying it out.
+  bool skipString() {
+    if (!expect('"')) {
+      return false;
+    }
+
+    while (position < end && *position != '"') {
+      position += *position == '\\' ? 2 : 1;
+    }
+
+    if (position >= end) {
+      return fail();
+    }
+    position++;
+    return true;
+  }
+
+  bool readString(string& value) {
+    if (!expect('"')) {
+      return false;
+    }
+
+    value.clear();
+    const char* start = position;
+    while (position < end && *position != '"') {
+      if (*position != '\\') {
+        position++;
+        continue;
+      }
+
+      value.append(start, position);
+      position++;
+      if (position >= end) {
+        return fail();
+      }
+
+      switch (*position) {
+        case 'b': value += '\b'; break;
+        case 'f': value += '\f'; break;
+        case 'n': value += '\n'; break;
+        case 'r': value += '\r'; break;
+        case 't': value += '\t'; break;
+        case 'u': {
+          // Only the Basic Latin range is decoded; anything else becomes '?'.
+          if (end - position < 5) {
+            return fail();
+          }
+          char hex[5] = { position[1], position[2], position[3], position[4], '\0' };
+          char* hexEnd;
+          long code = strtol(hex, &hexEnd, 16);
+          if (hexEnd != hex + 4) {
+            return fail();
+          }
+          value += code < 0x80 ? (char) code : '?';
+          position += 4;
+          break;
+        }
+        default: value += *position; break;
+      }
+      position++;
+      start = position;
+    }
+
+    if (position >= end) {
+      return fail();
+    }
+
+    value.append(start, position);
+    position++;
+    return true;
+  }
+
+  bool readNumber(double& value) {
+    skipWhitespace();
+    char* numberEnd;
+    value = strtod(position, &numberEnd);
+    if (numberEnd == position || numberEnd > end) {
+      return fail();
+    }
+    position = numberEnd;
+    return true;
+  }
+
+  bool readInt(int& value) {
+    skipWhitespace();
+
+    // Plain integers are by far the common case; leave fractions and
+    // exponents to strtod.
+    const char* digits = position;
+    bool negative = digits < end && *digits == '-';
+    if (negative) {
+      digits++;
+    }
+
+    int result = 0;
+    const char* digit = digits;
+    while (digit < end && *digit >= '0' && *digit <= '9' && digit - digits < 9) {
+      result = result * 10 + (*digit - '0');
+      digit++;
+    }
+
+    bool plain = digit > digits &&
+                 (digit >= end || (*digit != '.' && *digit != 'e' && *digit != 'E' &&
+                                   (*digit < '0' || *digit > '9')));
+    if (plain) {
+      value = negative ? -result : result;
+      position = digit;
+      return true;
+    }
+
+    double number;
+    if (!readNumber(number)) {
+      return false;
+    }
+    value = (int) number;
+    return true;
+  }
+
+  bool readBool(bool& value) {
+    skipWhitespace();
+    if (position < end && *position == 't') {
+      value = true;
+      return skipLiteral("true");
+    }
+    value = false;
+    return skipLiteral("false");
+  }
+
+  // Skips over the next value, whatever its type.
+  bool skipValue() {
+    skipWhitespace();
+    if (position >= end) {
+      return fail();
+    }
+
+    string ignored;
+    switch (*position) {
+      case '{':
+        if (!beginObject()) {
+          return false;
+        }
+        while (nextKey(ignored)) {
+          if (!skipValue()) {
+            return false;
+          }
+        }
+        return ok();
+      case '[':
+        if (!beginArray()) {
+          return false;
+        }
+        while (nextElement()) {
+          if (!skipValue()) {
+            return false;
+          }
+        }
+        return ok();
+      case '"':
+        return skipString();
+      case 't':
+        return skipLiteral("true");
+      case 'f':
+        return skipLiteral("false");
+      case 'n':
+        return skipLiteral("null");
+      default: {
+        double number;
+        return readNumber(number);
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef LOADER_INCLUDED
+#define LOADER_INCLUDED
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+
+using namespace std;
+
+// A surface decoded off the render thread, waiting to be uploaded. surface
+// is NULL if decoding failed.
+struct DecodedImage {
+  string path;
+  SDL_Surface* surface;
+};
+
+// Pool of worker threads that decode image files into SDL_Surfaces. Only
+// decoding happens here; creating textures from the surfaces must still be
+// done on the render thread.
+class TextureDecoder {
+ private:
+  vector<thread> workers;
+  mutex queueMutex;
+  condition_variable requestAvailable;
+  deque<string> requests;
+  deque<DecodedImage> decoded;
+  bool stopping;
+
+  void work() {
+    while (true) {
+      string path;
+      {
+        unique_lock<mutex> lock(queueMutex);
+        while (!stopping && requests.empty()) {
+          requestAvailable.wait(lock);
+        }
+
+        if (stopping) {
+          return;
+        }
+
+        path = requests.front();
+        requests.pop_front();
+      }
+
+      SDL_Surface* surface = IMG_Load(path.c_str());
+      if (surface == NULL) {
+        LOG("Unable to decode image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+      }
+
+      DecodedImage image = { path, surface };
+      lock_guard<mutex> lock(queueMutex);
+      decoded.push_back(image);
+    }
+  }
+
+ public:
+  TextureDecoder(int threadCount) {
+    stopping = false;
+    for (int i = 0; i < threadCount; i++) {
+      workers.push_back(thread(&TextureDecoder::work, this));
+    }
+  }
+
+  ~TextureDecoder() {
+    {
+      lock_guard<mutex> lock(queueMutex);
+      stopping = true;
+    }
+    requestAvailable.notify_all();
+
+    for (thread& worker : workers) {
+      worker.join();
+    }
+
+    for (DecodedImage& image : decoded) {
+      if (image.surface != NULL) {
+        SDL_FreeSurface(image.surface);
+      }
+    }
+  }
+
+  void request(const string& path) {
+    {
+      lock_guard<mutex> lock(queueMutex);
+      requests.push_back(path);
+    }
+    requestAvailable.notify_one();
+  }
+
+  // Takes the next decoded image, if any. The caller owns the surface.
+  bool poll(DecodedImage& image) {
+    lock_guard<mutex> lock(queueMutex);
+    if (decoded.empty()) {
+      return false;
+    }
+
+    image = decoded.front();
+    decoded.pop_front();
+    return true;
+  }
+};
+
+#endif
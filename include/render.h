@@ -5,17 +5,24 @@
 #include <SDL_image.h>
 #include <string>
 #include <memory>
+#include <vector>
 #include "common.h"
 #include "Box2D/Box2D.h"
 
 using namespace std;
 
 
+// A drawable image. Either owns an SDL_Texture outright, or refers to a
+// rectangular region of a shared page texture (see TextureAtlas). Width,
+// height and source rects passed to Renderer::render are always relative
+// to the region, so callers do not need to know which kind they have.
 class Texture {
 private:
 	SDL_Texture* texture;
-	int width;
-	int height;
+	shared_ptr<Texture> page;
+	SDL_Rect region;
+	int textureWidth;
+	int textureHeight;
 
 public:
 	Texture(SDL_Texture* texture) {
@@ -23,51 +30,169 @@ public:
 
 		Uint32 format;
 		int access;
-		SDL_QueryTexture(texture, &format, &access, &width, &height);
+		SDL_QueryTexture(texture, &format, &access, &textureWidth, &textureHeight);
+
+		region = { 0, 0, textureWidth, textureHeight };
+	}
+
+	Texture(shared_ptr<Texture> page, const SDL_Rect& region) {
+		this->texture = page->getSDLTexture();
+		this->page = page;
+		this->region = region;
+		textureWidth = page->getTextureWidth();
+		textureHeight = page->getTextureHeight();
 	}
 
 	~Texture() {
-		SDL_DestroyTexture(texture);
+		if (page.get() == NULL) {
+			SDL_DestroyTexture(texture);
+		}
 	}
 
 	SDL_Texture* getSDLTexture() const {
 		return texture;
 	}
 
+	// Area of the SDL texture covered by this texture.
+	const SDL_Rect& getRegion() const {
+		return region;
+	}
+
+	// Converts a rect relative to this texture, or NULL for all of it, into
+	// a rect on the underlying SDL texture.
+	SDL_Rect toTextureRect(const SDL_Rect* source) const {
+		if (source == NULL) {
+			return region;
+		}
+
+		SDL_Rect rect = { region.x + source->x, region.y + source->y, source->w, source->h };
+		return rect;
+	}
+
+	int getTextureWidth() const {
+		return textureWidth;
+	}
+
+	int getTextureHeight() const {
+		return textureHeight;
+	}
+
   int getWidth() const {
-    return width;
+    return region.w;
   }
 
   int getHeight() const {
-    return height;
+    return region.h;
   }
 };
 
+// SDL_RenderGeometry was added in SDL 2.0.18. Older versions fall back to
+// one SDL_RenderCopy per quad.
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define RENDER_BATCHING 1
+#endif
+
 class Renderer : public b2Draw {
 
 private:
 	SDL_Renderer* renderer;
 
+	// Quads queued for the texture in batchTexture. Consecutive quads that
+	// share a texture are drawn with a single geometry call; switching
+	// texture or draw state flushes the batch so draw order is preserved.
+	SDL_Texture* batchTexture;
+	vector<SDL_Vertex> batchVertices;
+	vector<int> batchIndices;
+
 public:
 	Renderer(SDL_Renderer* renderer) {
 		this->renderer = renderer;
+		batchTexture = NULL;
+		batchVertices.reserve(4096);
+		batchIndices.reserve(6144);
 	}
 
 	~Renderer() {
 		SDL_DestroyRenderer(renderer);
 	}
 
-	void clear() const {
-    SDL_SetRenderDrawColor( renderer, 0x00, 0x00, 0x00, 0xFF ); 
+	void clear() {
+		clear(0x00, 0x00, 0x00, 0xFF);
+	}
+
+	void clear(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+		flush();
+
+    SDL_SetRenderDrawColor( renderer, r, g, b, a ); 
 
 		SDL_RenderClear( renderer );
 	}
 
-	void render(const Texture& tex, SDL_Rect* source, SDL_Rect* dest) const {
-		SDL_RenderCopy(renderer, tex.getSDLTexture(), source, dest);	
+	void render(const Texture& tex, SDL_Rect* source, SDL_Rect* dest) {
+		SDL_Rect textureSource = tex.toTextureRect(source);
+
+#ifdef RENDER_BATCHING
+		if (dest == NULL) {
+			flush();
+			SDL_RenderCopy(renderer, tex.getSDLTexture(), &textureSource, dest);
+			return;
+		}
+
+		if (tex.getSDLTexture() != batchTexture) {
+			flush();
+			batchTexture = tex.getSDLTexture();
+		}
+
+		float invWidth = 1.0f / tex.getTextureWidth();
+		float invHeight = 1.0f / tex.getTextureHeight();
+		float u0 = textureSource.x * invWidth;
+		float v0 = textureSource.y * invHeight;
+		float u1 = (textureSource.x + textureSource.w) * invWidth;
+		float v1 = (textureSource.y + textureSource.h) * invHeight;
+
+		float x0 = (float) dest->x;
+		float y0 = (float) dest->y;
+		float x1 = (float) (dest->x + dest->w);
+		float y1 = (float) (dest->y + dest->h);
+
+		SDL_Color white = { 0xFF, 0xFF, 0xFF, 0xFF };
+		int base = (int) batchVertices.size();
+
+		batchVertices.push_back({ { x0, y0 }, white, { u0, v0 } });
+		batchVertices.push_back({ { x1, y0 }, white, { u1, v0 } });
+		batchVertices.push_back({ { x1, y1 }, white, { u1, v1 } });
+		batchVertices.push_back({ { x0, y1 }, white, { u0, v1 } });
+
+		batchIndices.push_back(base);
+		batchIndices.push_back(base + 1);
+		batchIndices.push_back(base + 2);
+		batchIndices.push_back(base);
+		batchIndices.push_back(base + 2);
+		batchIndices.push_back(base + 3);
+#else
+		SDL_RenderCopy(renderer, tex.getSDLTexture(), &textureSource, dest);	
+#endif
 	}
 
-	void present() const {
+	// Submits all queued quads. Called automatically on texture switches,
+	// before debug drawing and before presenting.
+	void flush() {
+#ifdef RENDER_BATCHING
+		if (!batchIndices.empty()) {
+			SDL_RenderGeometry(renderer, batchTexture,
+				batchVertices.data(), (int) batchVertices.size(),
+				batchIndices.data(), (int) batchIndices.size());
+		}
+
+		batchVertices.clear();
+		batchIndices.clear();
+		batchTexture = NULL;
+#endif
+	}
+
+	void present() {
+		flush();
+
 		SDL_RenderPresent( renderer );
 	}
 
@@ -86,8 +211,98 @@ public:
 		return true;
 	}
 
+	// Uploads a decoded surface. Must be called on the render thread.
+	bool createTexture(SDL_Surface* surface, shared_ptr<Texture>* texture) const {
+		SDL_Texture* sdlTex = SDL_CreateTextureFromSurface(renderer, surface);
+		if (sdlTex == NULL) {
+			LOG("Unable to create texture from surface! SDL Error: %s\n", SDL_GetError());
+			return false;
+		}
+
+		*texture = shared_ptr<Texture>(new Texture(sdlTex));
+
+		return true;
+	}
+
+	// Creates a 1x1 texture of a single color.
+	bool createSolidTexture(Uint8 r, Uint8 g, Uint8 b, Uint8 a, shared_ptr<Texture>* texture) const {
+		SDL_Texture* sdlTex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+			SDL_TEXTUREACCESS_STATIC, 1, 1);
+		if (sdlTex == NULL) {
+			LOG("Unable to create texture! SDL Error: %s\n", SDL_GetError());
+			return false;
+		}
+
+		Uint32 pixel = ((Uint32) r << 24) | ((Uint32) g << 16) | ((Uint32) b << 8) | a;
+		SDL_UpdateTexture(sdlTex, NULL, &pixel, sizeof(pixel));
+
+		*texture = shared_ptr<Texture>(new Texture(sdlTex));
+
+		return true;
+	}
+
+	// Creates a blank, transparent texture whose pixels are filled in with
+	// updateTexture.
+	bool createBlankTexture(int width, int height, shared_ptr<Texture>* texture) const {
+		SDL_Texture* sdlTex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+			SDL_TEXTUREACCESS_STATIC, width, height);
+		if (sdlTex == NULL) {
+			LOG("Unable to create texture! SDL Error: %s\n", SDL_GetError());
+			return false;
+		}
+
+		vector<Uint32> pixels(width * height, 0);
+		SDL_UpdateTexture(sdlTex, NULL, pixels.data(), width * sizeof(Uint32));
+		SDL_SetTextureBlendMode(sdlTex, SDL_BLENDMODE_BLEND);
+
+		*texture = shared_ptr<Texture>(new Texture(sdlTex));
+
+		return true;
+	}
+
+	// Copies a surface into part of a texture made by createBlankTexture.
+	bool updateTexture(const Texture& texture, const SDL_Rect& rect, SDL_Surface* surface) const {
+		SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA8888, 0);
+		if (converted == NULL) {
+			LOG("Unable to convert surface! SDL Error: %s\n", SDL_GetError());
+			return false;
+		}
+
+		SDL_Rect textureRect = texture.toTextureRect(&rect);
+		bool success = SDL_UpdateTexture(texture.getSDLTexture(), &textureRect,
+			converted->pixels, converted->pitch) == 0;
+		SDL_FreeSurface(converted);
+
+		return success;
+	}
+
+	// Creates a texture that can be drawn into with setRenderTarget.
+	bool createRenderTarget(int width, int height, shared_ptr<Texture>* texture) const {
+		SDL_Texture* sdlTex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+			SDL_TEXTUREACCESS_TARGET, width, height);
+		if (sdlTex == NULL) {
+			LOG("Unable to create render target! SDL Error: %s\n", SDL_GetError());
+			return false;
+		}
+
+		SDL_SetTextureBlendMode(sdlTex, SDL_BLENDMODE_BLEND);
+
+		*texture = shared_ptr<Texture>(new Texture(sdlTex));
+
+		return true;
+	}
+
+	// Redirects drawing into texture, or back to the window when NULL.
+	void setRenderTarget(const Texture* texture) {
+		flush();
+
+		SDL_SetRenderTarget(renderer, texture == NULL ? NULL : texture->getSDLTexture());
+	}
+
   /// Draw a closed polygon provided in CCW order.
   void DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) {
+    flush();
+
     if (vertexCount != 4) {
       LOG("Polygon is not a square!!\n");
     }
@@ -128,6 +343,8 @@ public:
 
   /// Draw a solid closed polygon provided in CCW order.
   void DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) {
+    flush();
+
     if (vertexCount != 4) {
       LOG("Polygon is not a square!!\n");
     }
@@ -184,6 +401,8 @@ public:
   /// Draw a transform. Choose your own length scale.
   /// @param xf a transform.
   void DrawTransform(const b2Transform& xf) {
+    flush();
+
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_Rect rect {
       (int) (xf.p.x * B2_UNITS_TO_PIXELS)-3,
@@ -206,7 +425,7 @@ public:
 		this->texture = texture;
 	}
 
-	void render(const Renderer& renderer, SDL_Rect* dest) {
+	void render(Renderer& renderer, SDL_Rect* dest) {
 		renderer.render(*texture, NULL, dest);
 	}
 };
@@ -235,7 +454,7 @@ bool createWindow(SDL_Window** window) {
 
 bool createRenderer(SDL_Window* window, shared_ptr<Renderer>* renderer) {
 	//Create renderer for window
-    SDL_Renderer* sdlRenderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED );
+    SDL_Renderer* sdlRenderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE );
     if( sdlRenderer == NULL )
     {
         LOG( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
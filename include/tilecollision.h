@@ -0,0 +1,156 @@
+#ifndef TILE_COLLISION_INCLUDED
+#define TILE_COLLISION_INCLUDED
+
+#include <vector>
+#include "common.h"
+#include "tiles.h"
+#include "Box2D/Box2D.h"
+
+using namespace std;
+
+// A rectangle of solid tiles, inclusive, in tile coordinates.
+struct TileRect {
+  int minX;
+  int minY;
+  int maxX;
+  int maxY;
+};
+
+// Builds static colliders for a TileMap. Solid tiles in each chunk are
+// greedily merged into as few rectangles as possible and attached to one
+// static body per chunk, so a long floor is a single box instead of a row
+// of boxes with seams between them. Only chunks whose contents changed are
+// rebuilt.
+class TileColliders {
+ private:
+  b2World& world;
+  const TileMap& tileMap;
+  vector<b2Body*> chunkBodies;
+  vector<unsigned int> builtRevisions;
+
+  void rebuildChunk(int chunkX, int chunkY) {
+    int index = chunkY * tileMap.getChunksWide() + chunkX;
+    if (chunkBodies[index] != NULL) {
+      world.DestroyBody(chunkBodies[index]);
+      chunkBodies[index] = NULL;
+    }
+
+    vector<TileRect> rects;
+    mergeChunk(chunkX, chunkY, rects);
+    if (rects.empty()) {
+      return;
+    }
+
+    float tileLength = tileMap.getTileLength() * PIXELS_TO_B2_UNITS;
+    int firstX = chunkX * TILE_CHUNK_SIZE;
+    int firstY = chunkY * TILE_CHUNK_SIZE;
+
+    // Tiles are centered on (x * tileLength, -y * tileLength).
+    b2BodyDef bodyDef;
+    bodyDef.position.Set(firstX * tileLength, -firstY * tileLength);
+    b2Body* body = world.CreateBody(&bodyDef);
+
+    for (const TileRect& rect : rects) {
+      b2Vec2 center(
+        ((rect.minX + rect.maxX) / 2.0f - firstX) * tileLength,
+        -((rect.minY + rect.maxY) / 2.0f - firstY) * tileLength);
+
+      b2PolygonShape box;
+      box.SetAsBox((rect.maxX - rect.minX + 1) * tileLength / 2.0f,
+                   (rect.maxY - rect.minY + 1) * tileLength / 2.0f,
+                   center, 0.0f);
+
+      body->CreateFixture(&box, 0.0f);
+    }
+
+    chunkBodies[index] = body;
+  }
+
+ public:
+  TileColliders(b2World& world, const TileMap& tileMap) : world(world), tileMap(tileMap) {
+    int chunkCount = tileMap.getChunksWide() * tileMap.getChunksHigh();
+    chunkBodies.resize(chunkCount, NULL);
+    builtRevisions.resize(chunkCount, 0);
+  }
+
+  ~TileColliders() {
+    for (b2Body* body : chunkBodies) {
+      if (body != NULL) {
+        world.DestroyBody(body);
+      }
+    }
+  }
+
+  // Rebuilds the colliders of every chunk changed since the last update.
+  // Must not be called during b2World::Step. All rebuilt chunks go into the
+  // broad-phase as one batch, which matters on the first update, when every
+  // chunk of the level is built. No batch is opened when nothing changed.
+  void update() {
+    bool batching = false;
+    for (int chunkY = 0; chunkY < tileMap.getChunksHigh(); chunkY++) {
+      for (int chunkX = 0; chunkX < tileMap.getChunksWide(); chunkX++) {
+        int index = chunkY * tileMap.getChunksWide() + chunkX;
+        unsigned int revision = tileMap.getChunkRevision(chunkX, chunkY);
+        if (revision != builtRevisions[index]) {
+          if (!batching) {
+            world.BeginStaticBatch();
+            batching = true;
+          }
+          rebuildChunk(chunkX, chunkY);
+          builtRevisions[index] = revision;
+        }
+      }
+    }
+    if (batching) {
+      world.EndStaticBatch();
+    }
+  }
+
+  // Covers the solid tiles of one chunk with rectangles. Each rectangle is
+  // grown along the row first, then down while the whole span stays solid.
+  void mergeChunk(int chunkX, int chunkY, vector<TileRect>& rects) const {
+    int firstX = chunkX * TILE_CHUNK_SIZE;
+    int firstY = chunkY * TILE_CHUNK_SIZE;
+    int width = min(TILE_CHUNK_SIZE, tileMap.getMapWidth() - firstX);
+    int height = min(TILE_CHUNK_SIZE, tileMap.getMapHeight() - firstY);
+
+    bool covered[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE] = {};
+
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        if (covered[y * TILE_CHUNK_SIZE + x] || !tileMap.isSolid(firstX + x, firstY + y)) {
+          continue;
+        }
+
+        int endX = x + 1;
+        while (endX < width && !covered[y * TILE_CHUNK_SIZE + endX] &&
+               tileMap.isSolid(firstX + endX, firstY + y)) {
+          endX++;
+        }
+
+        int endY = y + 1;
+        for (; endY < height; endY++) {
+          bool rowSolid = true;
+          for (int i = x; i < endX && rowSolid; i++) {
+            rowSolid = !covered[endY * TILE_CHUNK_SIZE + i] &&
+                       tileMap.isSolid(firstX + i, firstY + endY);
+          }
+          if (!rowSolid) {
+            break;
+          }
+        }
+
+        for (int j = y; j < endY; j++) {
+          for (int i = x; i < endX; i++) {
+            covered[j * TILE_CHUNK_SIZE + i] = true;
+          }
+        }
+
+        TileRect rect = { firstX + x, firstY + y, firstX + endX - 1, firstY + endY - 1 };
+        rects.push_back(rect);
+      }
+    }
+  }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define TILES_INCLUDED
 
 #include <SDL.h>
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
@@ -14,7 +15,8 @@ class TileDefinition;
 class TileInstance;
 
 typedef map<string, shared_ptr<TileDefinition> > NameToTileDefinitionMap;
-typedef map<int, shared_ptr<TileInstance> > PosToTileInstanceMap;
+typedef Uint16 TileId;
+typedef map<const TileInstance*, TileId> TileInstanceToTileIdMap;
 
 
 class TileDefinition {
@@ -46,7 +48,7 @@ class TileInstance {
     this->texture = texture;
   }
 
-  void render(const Renderer& renderer, int x , int y) {
+  void render(Renderer& renderer, int x , int y) {
     SDL_Rect* source = tileDefinition->getTexRect();
     SDL_Rect dest {x-source->w/2, y-source->w/2, source->w, source->h};
     renderer.render(*texture, source, &dest);
@@ -84,20 +86,120 @@ class TilePalette {
   }
 };
 
+// Tiles are stored in square chunks of this many tiles per side.
+const int TILE_CHUNK_SIZE = 32;
+
+// Tile ID stored in a chunk for an empty cell.
+const TileId EMPTY_TILE = 0;
+
+// A dense block of tile IDs. IDs index into the owning TileMap's tile types.
+struct TileChunk {
+  TileId tiles[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE];
+  int tileCount;
+
+  // Every tile in the chunk drawn into one texture, when chunk baking is on.
+  // Re-baked before the next draw whenever bakeDirty is set.
+  shared_ptr<Texture> bakedTexture;
+  bool bakeDirty;
+
+  // Incremented on every change so dependent data can detect stale chunks.
+  unsigned int revision;
+
+  TileChunk() {
+    fill(tiles, tiles + TILE_CHUNK_SIZE * TILE_CHUNK_SIZE, EMPTY_TILE);
+    tileCount = 0;
+    bakeDirty = true;
+    revision = 0;
+  }
+};
+
 class TileMap {
 private:
-  unique_ptr<PosToTileInstanceMap> tileInstances;
+  // Chunks in row-major order. Chunks that never had a tile stay null.
+  vector<unique_ptr<TileChunk> > chunks;
+  // Tile instance for each tile ID. Index 0 is EMPTY_TILE and stays null.
+  vector<shared_ptr<TileInstance> > tileTypes;
+  unique_ptr<TileInstanceToTileIdMap> tileIds;
   int mapWidth;
   int mapHeight;
+  int chunksWide;
+  int chunksHigh;
   int tileLength;
+  bool chunkBaking;
 
-  int convertToKey(int x, int y) {
-    return y * mapWidth + x;
+  bool inBounds(int x, int y) const {
+    return x >= 0 && y >= 0 && x < mapWidth && y < mapHeight;
   }
 
-  void convertKeyToXY(int key, int& x, int& y) {
-    x = key % mapWidth;
-    y = key / mapWidth;
+  int chunkIndex(int x, int y) const {
+    return (y / TILE_CHUNK_SIZE) * chunksWide + x / TILE_CHUNK_SIZE;
+  }
+
+  static int tileIndex(int x, int y) {
+    return (y % TILE_CHUNK_SIZE) * TILE_CHUNK_SIZE + x % TILE_CHUNK_SIZE;
+  }
+
+  static int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+  }
+
+  // Draws the tiles in [startX, endX] x [startY, endY] of one chunk, offset
+  // so that map pixel (originX, originY) lands on (0, 0).
+  void renderTiles(Renderer& renderer, const TileChunk& chunk,
+                   int startX, int endX, int startY, int endY, int originX, int originY) {
+    for (int y = startY; y <= endY; y++) {
+      const TileId* row = chunk.tiles + (y % TILE_CHUNK_SIZE) * TILE_CHUNK_SIZE;
+      for (int x = startX; x <= endX; x++) {
+        TileId id = row[x % TILE_CHUNK_SIZE];
+        if (id != EMPTY_TILE) {
+          tileTypes[id]->render(renderer, x * tileLength - originX, y * tileLength - originY);
+        }
+      }
+    }
+  }
+
+  // Rasterizes a whole chunk into its baked texture.
+  bool bakeChunk(Renderer& renderer, TileChunk& chunk, int chunkX, int chunkY) {
+    int chunkLength = TILE_CHUNK_SIZE * tileLength;
+    if (chunk.bakedTexture.get() == NULL &&
+        !renderer.createRenderTarget(chunkLength, chunkLength, &chunk.bakedTexture)) {
+      return false;
+    }
+
+    int firstX = chunkX * TILE_CHUNK_SIZE;
+    int firstY = chunkY * TILE_CHUNK_SIZE;
+
+    renderer.setRenderTarget(chunk.bakedTexture.get());
+    renderer.clear(0x00, 0x00, 0x00, 0x00);
+    renderTiles(renderer, chunk,
+                firstX, min(mapWidth, firstX + TILE_CHUNK_SIZE) - 1,
+                firstY, min(mapHeight, firstY + TILE_CHUNK_SIZE) - 1,
+                firstX * tileLength - tileLength / 2, firstY * tileLength - tileLength / 2);
+    renderer.setRenderTarget(NULL);
+
+    chunk.bakeDirty = false;
+    return true;
+  }
+
+  TileId getTileId(shared_ptr<TileInstance> tileInstance) {
+    if (tileInstance.get() == NULL) {
+      return EMPTY_TILE;
+    }
+
+    TileInstanceToTileIdMap::iterator it = tileIds->find(tileInstance.get());
+    if (it != tileIds->end()) {
+      return it->second;
+    }
+
+    if (tileTypes.size() > 0xFFFF) {
+      LOG("Too many tile types in map!\n");
+      return EMPTY_TILE;
+    }
+
+    TileId id = (TileId) tileTypes.size();
+    tileTypes.push_back(tileInstance);
+    (*tileIds)[tileInstance.get()] = id;
+    return id;
   }
 
 public:
@@ -105,7 +207,12 @@ public:
     this->mapWidth = mapWidth;
     this->mapHeight = mapHeight;
     this->tileLength = tileLength;
-    tileInstances = unique_ptr<PosToTileInstanceMap>(new PosToTileInstanceMap());
+    chunksWide = (mapWidth + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    chunksHigh = (mapHeight + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    chunkBaking = false;
+    chunks.resize(chunksWide * chunksHigh);
+    tileTypes.push_back(shared_ptr<TileInstance>());
+    tileIds = unique_ptr<TileInstanceToTileIdMap>(new TileInstanceToTileIdMap());
   }
 
   int getTileLength() const {
@@ -120,18 +227,126 @@ public:
     return mapHeight;
   }
 
+  int getChunksWide() const {
+    return chunksWide;
+  }
+
+  int getChunksHigh() const {
+    return chunksHigh;
+  }
+
+  // Revision of a chunk's contents. Chunks that were never written are 0.
+  unsigned int getChunkRevision(int chunkX, int chunkY) const {
+    const TileChunk* chunk = chunks[chunkY * chunksWide + chunkX].get();
+    return chunk == NULL ? 0 : chunk->revision;
+  }
+
+  // When enabled, each chunk is drawn into a texture once and rendered as a
+  // single quad until set() changes it. Meant for layers that rarely change.
+  void setChunkBaking(bool chunkBaking) {
+    this->chunkBaking = chunkBaking;
+    if (!chunkBaking) {
+      for (unique_ptr<TileChunk>& chunk : chunks) {
+        if (chunk.get() != NULL) {
+          chunk->bakedTexture.reset();
+          chunk->bakeDirty = true;
+        }
+      }
+    }
+  }
+
+  // Forces every baked chunk to be redrawn, e.g. after the renderer lost
+  // its render targets.
+  void invalidateBakedChunks() {
+    for (unique_ptr<TileChunk>& chunk : chunks) {
+      if (chunk.get() != NULL) {
+        chunk->bakeDirty = true;
+      }
+    }
+  }
+
+  // Places a tile. Passing a null instance clears the cell.
   void set(int x, int y, shared_ptr<TileInstance> tileInstance) {
-    (*tileInstances)[convertToKey(x,y)] = tileInstance;
+    if (!inBounds(x, y)) {
+      LOG("Tile out of bounds: X(%d) Y(%d)\n", x, y);
+      return;
+    }
+
+    TileId id = getTileId(tileInstance);
+    unique_ptr<TileChunk>& chunk = chunks[chunkIndex(x, y)];
+    if (chunk.get() == NULL) {
+      if (id == EMPTY_TILE) {
+        return;
+      }
+      chunk = unique_ptr<TileChunk>(new TileChunk());
+    }
+
+    TileId& tile = chunk->tiles[tileIndex(x, y)];
+    if (tile == id) {
+      return;
+    }
+    chunk->tileCount += (id != EMPTY_TILE) - (tile != EMPTY_TILE);
+    chunk->bakeDirty = true;
+    chunk->revision++;
+    tile = id;
+  }
+
+  TileId get(int x, int y) const {
+    if (!inBounds(x, y)) {
+      return EMPTY_TILE;
+    }
+
+    const TileChunk* chunk = chunks[chunkIndex(x, y)].get();
+    return chunk == NULL ? EMPTY_TILE : chunk->tiles[tileIndex(x, y)];
+  }
+
+  bool isSolid(int x, int y) const {
+    return get(x, y) != EMPTY_TILE;
   }
 
+  // Renders the tiles visible in a SCREEN_WIDTH x SCREEN_HEIGHT view whose
+  // top left corner is at (originX, originY) in map pixels.
   void render(Renderer& renderer, int originX, int originY) {
-    for (auto const& keyAndTileInstance : *tileInstances)
-    {
-        int x;
-        int y;
-        convertKeyToXY(keyAndTileInstance.first, x, y);
+    render(renderer, originX, originY, SCREEN_WIDTH, SCREEN_HEIGHT);
+  }
+
+  void render(Renderer& renderer, int originX, int originY, int viewWidth, int viewHeight) {
+    // Tiles are drawn centered on (x * tileLength, y * tileLength).
+    int halfLength = tileLength / 2;
+    int minX = max(0, floorDiv(originX - halfLength, tileLength));
+    int minY = max(0, floorDiv(originY - halfLength, tileLength));
+    int maxX = min(mapWidth - 1, floorDiv(originX + viewWidth + halfLength, tileLength));
+    int maxY = min(mapHeight - 1, floorDiv(originY + viewHeight + halfLength, tileLength));
+    if (minX > maxX || minY > maxY) {
+      return;
+    }
 
-        keyAndTileInstance.second->render(renderer, x * tileLength, y * tileLength);
+    for (int chunkY = minY / TILE_CHUNK_SIZE; chunkY <= maxY / TILE_CHUNK_SIZE; chunkY++) {
+      for (int chunkX = minX / TILE_CHUNK_SIZE; chunkX <= maxX / TILE_CHUNK_SIZE; chunkX++) {
+        TileChunk* chunk = chunks[chunkY * chunksWide + chunkX].get();
+        if (chunk == NULL || chunk->tileCount == 0) {
+          continue;
+        }
+
+        if (chunkBaking && (!chunk->bakeDirty || bakeChunk(renderer, *chunk, chunkX, chunkY))) {
+          int chunkLength = TILE_CHUNK_SIZE * tileLength;
+          SDL_Rect dest {
+            chunkX * chunkLength - halfLength - originX,
+            chunkY * chunkLength - halfLength - originY,
+            chunkLength,
+            chunkLength
+          };
+          renderer.render(*chunk->bakedTexture, NULL, &dest);
+          continue;
+        }
+
+        int startX = max(minX, chunkX * TILE_CHUNK_SIZE);
+        int endX = min(maxX, chunkX * TILE_CHUNK_SIZE + TILE_CHUNK_SIZE - 1);
+        int startY = max(minY, chunkY * TILE_CHUNK_SIZE);
+        int endY = min(maxY, chunkY * TILE_CHUNK_SIZE + TILE_CHUNK_SIZE - 1);
+
+        renderTiles(renderer, *chunk, startX, endX, startY, endY, originX, originY);
+      }
     }
   }
 };
@@ -0,0 +1,57 @@
+#ifndef TIMESTEP_INCLUDED
+#define TIMESTEP_INCLUDED
+
+#include <SDL.h>
+#include "common.h"
+
+// Upper bound on simulation steps run for a single rendered frame. A frame
+// that takes longer than this many steps drops the remaining time instead
+// of trying to catch up, so one slow frame cannot snowball.
+const int MAX_STEPS_PER_FRAME = 5;
+
+// Accumulates real time from the high-resolution counter and hands it out
+// in fixed-size simulation steps.
+class FixedTimestep {
+ private:
+  double stepDuration;
+  double accumulator;
+  Uint64 frequency;
+  Uint64 previousCounter;
+
+ public:
+  FixedTimestep(double stepDuration) {
+    this->stepDuration = stepDuration;
+    accumulator = 0.0;
+    frequency = SDL_GetPerformanceFrequency();
+    previousCounter = SDL_GetPerformanceCounter();
+  }
+
+  // Adds the time elapsed since the previous call and returns the number of
+  // steps the simulation should run this frame.
+  int advance() {
+    Uint64 counter = SDL_GetPerformanceCounter();
+    accumulator += (counter - previousCounter) / (double) frequency;
+    previousCounter = counter;
+
+    int steps = (int) (accumulator / stepDuration);
+    if (steps > MAX_STEPS_PER_FRAME) {
+      steps = MAX_STEPS_PER_FRAME;
+      accumulator = steps * stepDuration;
+    }
+
+    accumulator -= steps * stepDuration;
+    return steps;
+  }
+
+  // How far the current time is between the last two simulation states,
+  // in [0, 1). Used to interpolate what gets rendered.
+  float getAlpha() const {
+    return (float) (accumulator / stepDuration);
+  }
+
+  double getStepDuration() const {
+    return stepDuration;
+  }
+};
+
+#endif
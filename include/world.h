@@ -0,0 +1,132 @@
+#ifndef WORLD_INCLUDED
+#define WORLD_INCLUDED
+
+#include <memory>
+#include "common.h"
+#include "jobs.h"
+#include "tiles.h"
+#include "tilecollision.h"
+#include "Box2D/Box2D.h"
+
+using namespace std;
+
+const float32 WORLD_GRAVITY = -1.0f;
+
+const float PLAYER_SPEED = 200.0f / 10000;  // per ms
+
+// Lets the physics world solve its islands on the game's JobSystem. Step the
+// world from a thread the JobSystem owns, normally the main thread.
+class JobSystemTaskExecutor : public b2TaskExecutor {
+ private:
+  JobSystem& jobs;
+
+ public:
+  JobSystemTaskExecutor(JobSystem& jobs) : jobs(jobs) {}
+
+  int32 GetThreadCount() const {
+    return jobs.getThreadCount();
+  }
+
+  void ParallelFor(b2Task* task, int32 count) {
+    // Thread indices select per-thread solver state, and the JobSystem has
+    // no index for a thread it does not own. Such a caller runs the items
+    // itself as thread 0, since no other thread touches this step meanwhile.
+    int32 worker = JobSystem::getCurrentWorker();
+    b2Assert(worker >= 0);
+    if (worker < 0) {
+      for (int32 i = 0; i < count; i++) {
+        task->Execute(i, 0);
+      }
+      return;
+    }
+
+    JobCounter counter;
+    jobs.parallelFor(count, 1, [task](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        task->Execute(i, JobSystem::getCurrentWorker());
+      }
+    }, &counter);
+    jobs.wait(counter);
+  }
+};
+
+struct PlayerInput {
+  bool up = false;
+  bool down = false;
+  bool left = false;
+  bool right = false;
+};
+
+// Lays out the test level used by runGame().
+// Static colliders for the tiles are built separately, see TileColliders.
+void createLevel(TileMap& tileMap, shared_ptr<TileInstance> tileInstance) {
+  tileMap.set(4, 4, tileInstance);
+  tileMap.set(4, 5, tileInstance);
+  tileMap.set(4, 6, tileInstance);
+  tileMap.set(5, 6, tileInstance);
+  tileMap.set(6, 6, tileInstance);
+  tileMap.set(7, 6, tileInstance);
+
+  tileMap.set(9, 6, tileInstance);
+  tileMap.set(10, 6, tileInstance);
+  tileMap.set(11, 6, tileInstance);
+  tileMap.set(12, 6, tileInstance);
+  tileMap.set(12, 5, tileInstance);
+  tileMap.set(12, 4, tileInstance);
+  tileMap.set(13, 4, tileInstance);
+  tileMap.set(14, 4, tileInstance);
+}
+
+// Creates the dynamic player box. Width and height are in pixels.
+b2Body* createPlayerBody(b2World& world, int width, int height) {
+  // Define the dynamic body. We set its position and call the body factory.
+	b2BodyDef bodyDef;
+	bodyDef.type = b2_dynamicBody;
+	bodyDef.position.Set(200.0f * PIXELS_TO_B2_UNITS, -150.0f * PIXELS_TO_B2_UNITS);
+	bodyDef.gravityScale = 1.0f;
+	b2Body* playerBody = world.CreateBody(&bodyDef);
+
+	// Define another box shape for our dynamic body.
+	b2PolygonShape dynamicBox;
+	dynamicBox.SetAsBox(width * PIXELS_TO_B2_UNITS/2.0f, height * PIXELS_TO_B2_UNITS/2.0f);
+
+	// Define the dynamic body fixture.
+	b2FixtureDef fixtureDef;
+	fixtureDef.shape = &dynamicBox;
+
+	// Set the box density to be non-zero, so it will be dynamic.
+	fixtureDef.density = 20.0f;
+
+	// Override the default friction.
+	fixtureDef.friction = 0.3f;
+
+	// Add the shape to the body.
+	playerBody->CreateFixture(&fixtureDef);
+
+  return playerBody;
+}
+
+// Applies the player's movement impulse for a frame lasting dt milliseconds.
+void applyPlayerInput(b2Body* playerBody, const PlayerInput& input, float dt) {
+  b2Vec2 velocity(0.0f, 0.0f);
+  if (input.up) {
+    velocity.y -= PLAYER_SPEED * dt;
+  }
+
+  if (input.down) {
+    velocity.y += PLAYER_SPEED * dt;
+  }
+
+  if (input.right) {
+    velocity.x += PLAYER_SPEED * dt;
+  }
+
+  if (input.left) {
+    velocity.x -= PLAYER_SPEED * dt;
+  }
+
+  b2Vec2 p = playerBody->GetWorldPoint(b2Vec2(0.0f, 0.0f));
+  playerBody->ApplyLinearImpulse(playerBody->GetWorldVector(velocity), p, true);
+}
+
+#endif
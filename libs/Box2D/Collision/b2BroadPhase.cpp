@@ -18,46 +18,127 @@
 
 #include <Box2D/Collision/b2BroadPhase.h>
 
-b2BroadPhase::b2BroadPhase()
+b2BroadPhase::b2BroadPhase(b2BroadPhaseType type)
 {
+	m_type = type;
 	m_proxyCount = 0;
+	m_staticProxyCount = 0;
 
 	m_pairCapacity = 16;
 	m_pairCount = 0;
-	m_pairBuffer = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
+	m_pairBuffer = (uint64*)b2Alloc(m_pairCapacity * sizeof(uint64));
+	m_pairScratch = (uint64*)b2Alloc(m_pairCapacity * sizeof(uint64));
 
 	m_moveCapacity = 16;
 	m_moveCount = 0;
 	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+
+	m_moveIndexCapacity = 32;
+	m_moveIndex = (int32*)b2Alloc(m_moveIndexCapacity * sizeof(int32));
+	for (int32 i = 0; i < m_moveIndexCapacity; ++i)
+	{
+		m_moveIndex[i] = e_nullProxy;
+	}
+
+	m_wideTreeValid = false;
+	m_staleQueryCount = 0;
 }
 
 b2BroadPhase::~b2BroadPhase()
 {
+	b2Free(m_moveIndex);
 	b2Free(m_moveBuffer);
+	b2Free(m_pairScratch);
 	b2Free(m_pairBuffer);
 }
 
-int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
+int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData, bool isStatic)
 {
-	int32 proxyId = m_tree.CreateProxy(aabb, userData);
+	int32 proxyId;
+	if (isStatic)
+	{
+		proxyId = (m_staticTree.CreateProxy(aabb, userData) << 1) | 1;
+		++m_staticProxyCount;
+		InvalidateWideTree();
+	}
+	else if (m_type == b2_sweepBroadPhase)
+	{
+		proxyId = m_sweep.CreateProxy(aabb, userData) << 1;
+	}
+	else
+	{
+		proxyId = m_tree.CreateProxy(aabb, userData) << 1;
+	}
+
 	++m_proxyCount;
 	BufferMove(proxyId);
 	return proxyId;
 }
 
+void b2BroadPhase::CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, bool isStatic, int32* proxyIds)
+{
+	if (isStatic)
+	{
+		m_staticTree.CreateProxies(aabbs, userData, count, proxyIds);
+		m_staticProxyCount += count;
+		InvalidateWideTree();
+	}
+	else if (m_type == b2_sweepBroadPhase)
+	{
+		m_sweep.CreateProxies(aabbs, userData, count, proxyIds);
+	}
+	else
+	{
+		m_tree.CreateProxies(aabbs, userData, count, proxyIds);
+	}
+
+	m_proxyCount += count;
+	for (int32 i = 0; i < count; ++i)
+	{
+		proxyIds[i] = (proxyIds[i] << 1) | (isStatic ? 1 : 0);
+		BufferMove(proxyIds[i]);
+	}
+}
+
 void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+	if (InSweep(proxyId))
+	{
+		m_sweep.DestroyProxy(proxyId >> 1);
+	}
+	else
+	{
+		GetTree(proxyId).DestroyProxy(proxyId >> 1);
+	}
+
+	if (IsStatic(proxyId))
+	{
+		--m_staticProxyCount;
+		InvalidateWideTree();
+	}
 }
 
 void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	bool buffer;
+	if (InSweep(proxyId))
+	{
+		buffer = m_sweep.MoveProxy(proxyId >> 1, aabb, displacement);
+	}
+	else
+	{
+		buffer = GetTree(proxyId).MoveProxy(proxyId >> 1, aabb, displacement);
+	}
 	if (buffer)
 	{
 		BufferMove(proxyId);
+
+		if (IsStatic(proxyId))
+		{
+			InvalidateWideTree();
+		}
 	}
 }
 
@@ -66,8 +147,34 @@ void b2BroadPhase::TouchProxy(int32 proxyId)
 	BufferMove(proxyId);
 }
 
+void b2BroadPhase::InvalidateWideTree()
+{
+	m_wideTreeValid = false;
+	m_staleQueryCount = 0;
+}
+
 void b2BroadPhase::BufferMove(int32 proxyId)
 {
+	if (proxyId >= m_moveIndexCapacity)
+	{
+		int32* oldIndex = m_moveIndex;
+		int32 oldCapacity = m_moveIndexCapacity;
+		m_moveIndexCapacity = b2Max(2 * m_moveIndexCapacity, proxyId + 1);
+		m_moveIndex = (int32*)b2Alloc(m_moveIndexCapacity * sizeof(int32));
+		memcpy(m_moveIndex, oldIndex, oldCapacity * sizeof(int32));
+		for (int32 i = oldCapacity; i < m_moveIndexCapacity; ++i)
+		{
+			m_moveIndex[i] = e_nullProxy;
+		}
+		b2Free(oldIndex);
+	}
+
+	// Already buffered this step.
+	if (m_moveIndex[proxyId] != e_nullProxy)
+	{
+		return;
+	}
+
 	if (m_moveCount == m_moveCapacity)
 	{
 		int32* oldBuffer = m_moveBuffer;
@@ -77,22 +184,21 @@ void b2BroadPhase::BufferMove(int32 proxyId)
 		b2Free(oldBuffer);
 	}
 
+	m_moveIndex[proxyId] = m_moveCount;
 	m_moveBuffer[m_moveCount] = proxyId;
 	++m_moveCount;
 }
 
 void b2BroadPhase::UnBufferMove(int32 proxyId)
 {
-	for (int32 i = 0; i < m_moveCount; ++i)
+	if (IsBuffered(proxyId))
 	{
-		if (m_moveBuffer[i] == proxyId)
-		{
-			m_moveBuffer[i] = e_nullProxy;
-		}
+		m_moveBuffer[m_moveIndex[proxyId]] = e_nullProxy;
+		m_moveIndex[proxyId] = e_nullProxy;
 	}
 }
 
-// This is called from b2DynamicTree::Query when we are gathering pairs.
+// This is called from the tree queries in UpdatePairs when we are gathering pairs.
 bool b2BroadPhase::QueryCallback(int32 proxyId)
 {
 	// A proxy cannot form a pair with itself.
@@ -101,19 +207,79 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 		return true;
 	}
 
+	// When both proxies moved, the query of each finds the other, so only
+	// the query of the larger id adds the pair.
+	if (proxyId > m_queryProxyId && IsBuffered(proxyId))
+	{
+		return true;
+	}
+
 	// Grow the pair buffer as needed.
 	if (m_pairCount == m_pairCapacity)
 	{
-		b2Pair* oldBuffer = m_pairBuffer;
+		uint64* oldBuffer = m_pairBuffer;
 		m_pairCapacity *= 2;
-		m_pairBuffer = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
-		memcpy(m_pairBuffer, oldBuffer, m_pairCount * sizeof(b2Pair));
+		m_pairBuffer = (uint64*)b2Alloc(m_pairCapacity * sizeof(uint64));
+		memcpy(m_pairBuffer, oldBuffer, m_pairCount * sizeof(uint64));
 		b2Free(oldBuffer);
+
+		b2Free(m_pairScratch);
+		m_pairScratch = (uint64*)b2Alloc(m_pairCapacity * sizeof(uint64));
 	}
 
-	m_pairBuffer[m_pairCount].proxyIdA = b2Min(proxyId, m_queryProxyId);
-	m_pairBuffer[m_pairCount].proxyIdB = b2Max(proxyId, m_queryProxyId);
+	m_pairBuffer[m_pairCount] = b2PairKey(proxyId, m_queryProxyId);
 	++m_pairCount;
 
 	return true;
 }
+
+// Least significant digit first radix sort of the pair keys, one byte per
+// pass. Proxy ids are small, so most of the high bytes are the same in every
+// key and those passes are skipped.
+void b2BroadPhase::SortPairs()
+{
+	if (m_pairCount < b2_radixSortMinCount)
+	{
+		std::sort(m_pairBuffer, m_pairBuffer + m_pairCount);
+		return;
+	}
+
+	int32 counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (int32 i = 0; i < m_pairCount; ++i)
+	{
+		uint64 key = m_pairBuffer[i];
+		for (int32 pass = 0; pass < 8; ++pass)
+		{
+			++counts[pass][(key >> (8 * pass)) & 0xFF];
+		}
+	}
+
+	for (int32 pass = 0; pass < 8; ++pass)
+	{
+		int32 shift = 8 * pass;
+		int32* count = counts[pass];
+		if (count[(m_pairBuffer[0] >> shift) & 0xFF] == m_pairCount)
+		{
+			continue;
+		}
+
+		int32 offset = 0;
+		for (int32 digit = 0; digit < 256; ++digit)
+		{
+			int32 digitCount = count[digit];
+			count[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (int32 i = 0; i < m_pairCount; ++i)
+		{
+			uint64 key = m_pairBuffer[i];
+			int32 digit = int32((key >> shift) & 0xFF);
+			m_pairScratch[count[digit]] = key;
+			++count[digit];
+		}
+
+		b2Swap(m_pairBuffer, m_pairScratch);
+	}
+}
@@ -22,17 +22,78 @@
 #include <Box2D/Common/b2Settings.h>
 #include <Box2D/Collision/b2Collision.h>
 #include <Box2D/Collision/b2DynamicTree.h>
+#include <Box2D/Collision/b2SweepAndPrune.h>
+#include <Box2D/Collision/b2WideTree.h>
 #include <algorithm>
 
-struct b2Pair
+/// UpdatePairs rebuilds the wide copy of the static tree once the queries run
+/// against the stale tree reach one per this many static proxies.
+const int32 b2_wideTreeRebuildRatio = 32;
+
+/// Sort pair buffers smaller than this with std::sort instead of a radix sort.
+const int32 b2_radixSortMinCount = 256;
+
+/// A pair is packed into one key with the smaller proxy id in the high half,
+/// so sorting the keys sorts the pairs by proxy id.
+inline uint64 b2PairKey(int32 proxyIdA, int32 proxyIdB)
+{
+	uint64 lower = (uint32)b2Min(proxyIdA, proxyIdB);
+	uint64 upper = (uint32)b2Max(proxyIdA, proxyIdB);
+	return (lower << 32) | upper;
+}
+
+/// Forwards the callbacks of one broad-phase tree to a client, turning the
+/// tree's proxy ids into broad-phase proxy ids. It remembers whether the client
+/// stopped the query and how far the client clipped the ray, so that the
+/// query can continue in the other tree.
+template <typename T>
+struct b2BroadPhaseCallback
+{
+	bool QueryCallback(int32 treeProxyId)
+	{
+		proceed = callback->QueryCallback((treeProxyId << 1) | staticBit);
+		return proceed;
+	}
+
+	float32 RayCastCallback(const b2RayCastInput& input, int32 treeProxyId)
+	{
+		float32 value = callback->RayCastCallback(input, (treeProxyId << 1) | staticBit);
+		if (value == 0.0f)
+		{
+			proceed = false;
+		}
+		else if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+		return value;
+	}
+
+	T* callback;
+	int32 staticBit;
+	bool proceed;
+	float32 maxFraction;
+};
+
+/// The structure that holds the proxies that are not static.
+enum b2BroadPhaseType
 {
-	int32 proxyIdA;
-	int32 proxyIdB;
+	b2_treeBroadPhase,	///< b2DynamicTree, good for most scenes
+	b2_sweepBroadPhase	///< b2SweepAndPrune, for many similar moving bodies spread along x
 };
 
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
+///
+/// Static proxies are kept in a tree of their own. Moving proxies only need to
+/// search it for new pairs, and static proxies never need to search each other,
+/// so the per step cost does not grow with the amount of static geometry.
+/// Queries use a b2WideTree copy of the static tree while it is up to date.
+///
+/// The other proxies go in a b2DynamicTree or, for scenes of many similarly
+/// sized bodies that all keep moving, a b2SweepAndPrune. Either way the
+/// interface and the reported pairs are the same.
 class b2BroadPhase
 {
 public:
@@ -42,12 +103,22 @@ public:
 		e_nullProxy = -1
 	};
 
-	b2BroadPhase();
+	b2BroadPhase(b2BroadPhaseType type = b2_treeBroadPhase);
 	~b2BroadPhase();
 
+	/// Get the structure that holds the proxies that are not static.
+	b2BroadPhaseType GetType() const;
+
 	/// Create a proxy with an initial AABB. Pairs are not reported until
 	/// UpdatePairs is called.
-	int32 CreateProxy(const b2AABB& aabb, void* userData);
+	/// @param isStatic true for proxies that rarely move and never need to
+	/// pair with each other, such as the fixtures of static bodies.
+	int32 CreateProxy(const b2AABB& aabb, void* userData, bool isStatic = false);
+
+	/// Create many proxies in the same tree at once, much faster than calling
+	/// CreateProxy for each. See b2DynamicTree::CreateProxies.
+	/// @param proxyIds receives the id of each new proxy.
+	void CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, bool isStatic, int32* proxyIds);
 
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int32 proxyId);
@@ -65,6 +136,9 @@ public:
 	/// Get user data from a proxy. Returns NULL if the id is invalid.
 	void* GetUserData(int32 proxyId) const;
 
+	/// Is this proxy in the static tree?
+	bool IsStatic(int32 proxyId) const;
+
 	/// Test overlap of fat AABBs.
 	bool TestOverlap(int32 proxyIdA, int32 proxyIdB) const;
 
@@ -90,13 +164,14 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
-	/// Get the height of the embedded tree.
+	/// Get the height of the taller of the two trees. The sweep and prune
+	/// counts as an empty tree here and below.
 	int32 GetTreeHeight() const;
 
-	/// Get the balance of the embedded tree.
+	/// Get the worse balance of the two trees.
 	int32 GetTreeBalance() const;
 
-	/// Get the quality metric of the embedded tree.
+	/// Get the worse quality metric of the two trees.
 	float32 GetTreeQuality() const;
 
 	/// Shift the world origin. Useful for large worlds.
@@ -106,59 +181,118 @@ public:
 
 private:
 
-	friend class b2DynamicTree;
+	template <typename T>
+	friend struct b2BroadPhaseCallback;
+
+	// A broad-phase proxy id is the proxy id in its tree shifted left by one,
+	// with the low bit set for proxies in the static tree.
+	// With b2_sweepBroadPhase the proxies that are not static are in m_sweep
+	// instead of m_tree.
+	const b2DynamicTree& GetTree(int32 proxyId) const;
+	b2DynamicTree& GetTree(int32 proxyId);
+	bool InSweep(int32 proxyId) const;
 
 	void BufferMove(int32 proxyId);
 	void UnBufferMove(int32 proxyId);
+	bool IsBuffered(int32 proxyId) const;
+	void InvalidateWideTree();
 
 	bool QueryCallback(int32 proxyId);
+	void SortPairs();
 
+	template <typename T>
+	void QueryMoving(b2BroadPhaseCallback<T>* callback, const b2AABB& aabb) const;
+
+	template <typename T>
+	void QueryStatic(b2BroadPhaseCallback<T>* callback, const b2AABB& aabb) const;
+
+	b2BroadPhaseType m_type;
 	b2DynamicTree m_tree;
+	b2SweepAndPrune m_sweep;
+	b2DynamicTree m_staticTree;
+
+	// Copy of m_staticTree for queries, valid until the next change to it.
+	// m_staleQueryCount counts the pair queries run since that change.
+	b2WideTree m_wideTree;
+	bool m_wideTreeValid;
+	int32 m_staleQueryCount;
 
 	int32 m_proxyCount;
+	int32 m_staticProxyCount;
 
 	int32* m_moveBuffer;
 	int32 m_moveCapacity;
 	int32 m_moveCount;
 
-	b2Pair* m_pairBuffer;
+	// The position of each proxy in m_moveBuffer, or e_nullProxy, indexed by
+	// proxy id. Makes UnBufferMove constant time and keeps a proxy from
+	// being buffered twice.
+	int32* m_moveIndex;
+	int32 m_moveIndexCapacity;
+
+	// Pair keys, see b2PairKey. The scratch buffer has the same capacity and
+	// is used by the radix sort.
+	uint64* m_pairBuffer;
+	uint64* m_pairScratch;
 	int32 m_pairCapacity;
 	int32 m_pairCount;
 
 	int32 m_queryProxyId;
 };
 
-/// This is used to sort pairs.
-inline bool b2PairLessThan(const b2Pair& pair1, const b2Pair& pair2)
+inline const b2DynamicTree& b2BroadPhase::GetTree(int32 proxyId) const
 {
-	if (pair1.proxyIdA < pair2.proxyIdA)
-	{
-		return true;
-	}
+	return (proxyId & 1) ? m_staticTree : m_tree;
+}
+
+inline b2DynamicTree& b2BroadPhase::GetTree(int32 proxyId)
+{
+	return (proxyId & 1) ? m_staticTree : m_tree;
+}
 
-	if (pair1.proxyIdA == pair2.proxyIdA)
+inline bool b2BroadPhase::InSweep(int32 proxyId) const
+{
+	return m_type == b2_sweepBroadPhase && (proxyId & 1) == 0;
+}
+
+inline b2BroadPhaseType b2BroadPhase::GetType() const
+{
+	return m_type;
+}
+
+inline void* b2BroadPhase::GetUserData(int32 proxyId) const
+{
+	if (InSweep(proxyId))
 	{
-		return pair1.proxyIdB < pair2.proxyIdB;
+		return m_sweep.GetUserData(proxyId >> 1);
 	}
+	return GetTree(proxyId).GetUserData(proxyId >> 1);
+}
 
-	return false;
+inline bool b2BroadPhase::IsStatic(int32 proxyId) const
+{
+	return (proxyId & 1) != 0;
 }
 
-inline void* b2BroadPhase::GetUserData(int32 proxyId) const
+inline bool b2BroadPhase::IsBuffered(int32 proxyId) const
 {
-	return m_tree.GetUserData(proxyId);
+	return proxyId < m_moveIndexCapacity && m_moveIndex[proxyId] != e_nullProxy;
 }
 
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
-	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const b2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const b2AABB& aabbA = GetFatAABB(proxyIdA);
+	const b2AABB& aabbB = GetFatAABB(proxyIdB);
 	return b2TestOverlap(aabbA, aabbB);
 }
 
 inline const b2AABB& b2BroadPhase::GetFatAABB(int32 proxyId) const
 {
-	return m_tree.GetFatAABB(proxyId);
+	if (InSweep(proxyId))
+	{
+		return m_sweep.GetFatAABB(proxyId >> 1);
+	}
+	return GetTree(proxyId).GetFatAABB(proxyId >> 1);
 }
 
 inline int32 b2BroadPhase::GetProxyCount() const
@@ -168,17 +302,43 @@ inline int32 b2BroadPhase::GetProxyCount() const
 
 inline int32 b2BroadPhase::GetTreeHeight() const
 {
-	return m_tree.GetHeight();
+	return b2Max(m_tree.GetHeight(), m_staticTree.GetHeight());
 }
 
 inline int32 b2BroadPhase::GetTreeBalance() const
 {
-	return m_tree.GetMaxBalance();
+	return b2Max(m_tree.GetMaxBalance(), m_staticTree.GetMaxBalance());
 }
 
 inline float32 b2BroadPhase::GetTreeQuality() const
 {
-	return m_tree.GetAreaRatio();
+	return b2Max(m_tree.GetAreaRatio(), m_staticTree.GetAreaRatio());
+}
+
+template <typename T>
+inline void b2BroadPhase::QueryMoving(b2BroadPhaseCallback<T>* callback, const b2AABB& aabb) const
+{
+	if (m_type == b2_sweepBroadPhase)
+	{
+		m_sweep.Query(callback, aabb);
+	}
+	else
+	{
+		m_tree.Query(callback, aabb);
+	}
+}
+
+template <typename T>
+inline void b2BroadPhase::QueryStatic(b2BroadPhaseCallback<T>* callback, const b2AABB& aabb) const
+{
+	if (m_wideTreeValid)
+	{
+		m_wideTree.Query(callback, aabb);
+	}
+	else
+	{
+		m_staticTree.Query(callback, aabb);
+	}
 }
 
 template <typename T>
@@ -187,6 +347,21 @@ void b2BroadPhase::UpdatePairs(T* callback)
 	// Reset pair buffer
 	m_pairCount = 0;
 
+	// Once the queries against the stale static tree have cost about as much
+	// as a rebuild, rebuild it.
+	if (m_wideTreeValid == false)
+	{
+		m_staleQueryCount += m_moveCount;
+		if (b2_wideTreeRebuildRatio * m_staleQueryCount >= m_staticProxyCount)
+		{
+			m_wideTree.Build(m_staticTree);
+			m_wideTreeValid = true;
+		}
+	}
+
+	b2BroadPhaseCallback<b2BroadPhase> treeCallback;
+	treeCallback.callback = this;
+
 	// Perform tree queries for all moving proxies.
 	for (int32 i = 0; i < m_moveCount; ++i)
 	{
@@ -198,37 +373,48 @@ void b2BroadPhase::UpdatePairs(T* callback)
 
 		// We have to query the tree with the fat AABB so that
 		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
+		const b2AABB& fatAABB = GetFatAABB(m_queryProxyId);
 
 		// Query tree, create pairs and add them pair buffer.
-		m_tree.Query(this, fatAABB);
+		treeCallback.staticBit = 0;
+		QueryMoving(&treeCallback, fatAABB);
+
+		// Static proxies never pair with each other.
+		if (IsStatic(m_queryProxyId) == false)
+		{
+			treeCallback.staticBit = 1;
+			QueryStatic(&treeCallback, fatAABB);
+		}
 	}
 
 	// Reset move buffer
+	for (int32 i = 0; i < m_moveCount; ++i)
+	{
+		if (m_moveBuffer[i] != e_nullProxy)
+		{
+			m_moveIndex[m_moveBuffer[i]] = e_nullProxy;
+		}
+	}
 	m_moveCount = 0;
 
-	// Sort the pair buffer to expose duplicates.
-	std::sort(m_pairBuffer, m_pairBuffer + m_pairCount, b2PairLessThan);
+	// Sort the pair buffer so that the pairs are reported in a fixed order
+	// and any duplicates are next to each other.
+	SortPairs();
 
 	// Send the pairs back to the client.
 	int32 i = 0;
 	while (i < m_pairCount)
 	{
-		b2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		uint64 key = m_pairBuffer[i];
+		void* userDataA = GetUserData(int32(key >> 32));
+		void* userDataB = GetUserData(int32(key & 0xFFFFFFFF));
 
 		callback->AddPair(userDataA, userDataB);
 		++i;
 
 		// Skip any duplicate pairs.
-		while (i < m_pairCount)
+		while (i < m_pairCount && m_pairBuffer[i] == key)
 		{
-			b2Pair* pair = m_pairBuffer + i;
-			if (pair->proxyIdA != primaryPair->proxyIdA || pair->proxyIdB != primaryPair->proxyIdB)
-			{
-				break;
-			}
 			++i;
 		}
 	}
@@ -240,18 +426,61 @@ void b2BroadPhase::UpdatePairs(T* callback)
 template <typename T>
 inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	b2BroadPhaseCallback<T> treeCallback;
+	treeCallback.callback = callback;
+	treeCallback.staticBit = 0;
+	treeCallback.proceed = true;
+	QueryMoving(&treeCallback, aabb);
+
+	if (treeCallback.proceed)
+	{
+		treeCallback.staticBit = 1;
+		QueryStatic(&treeCallback, aabb);
+	}
 }
 
 template <typename T>
 inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
 {
-	m_tree.RayCast(callback, input);
+	b2BroadPhaseCallback<T> treeCallback;
+	treeCallback.callback = callback;
+	treeCallback.staticBit = 0;
+	treeCallback.proceed = true;
+	treeCallback.maxFraction = input.maxFraction;
+	if (m_type == b2_sweepBroadPhase)
+	{
+		m_sweep.RayCast(&treeCallback, input);
+	}
+	else
+	{
+		m_tree.RayCast(&treeCallback, input);
+	}
+
+	if (treeCallback.proceed == false)
+	{
+		return;
+	}
+
+	// Carry over any clipping from the moving proxies.
+	b2RayCastInput staticInput = input;
+	staticInput.maxFraction = treeCallback.maxFraction;
+	treeCallback.staticBit = 1;
+	if (m_wideTreeValid)
+	{
+		m_wideTree.RayCast(&treeCallback, staticInput);
+	}
+	else
+	{
+		m_staticTree.RayCast(&treeCallback, staticInput);
+	}
 }
 
 inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	m_tree.ShiftOrigin(newOrigin);
+	m_sweep.ShiftOrigin(newOrigin);
+	m_staticTree.ShiftOrigin(newOrigin);
+	InvalidateWideTree();
 }
 
 #endif
@@ -118,6 +118,274 @@ int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
 	return proxyId;
 }
 
+// The number of bins per split in BuildTopDown.
+const int32 b2_buildBinCount = 16;
+
+struct b2BuildBin
+{
+	b2AABB aabb;
+	int32 count;
+};
+
+// The leaves are copied out of the node pool for the build so that the
+// repeated passes over them read memory in order.
+struct b2BuildLeaf
+{
+	b2AABB aabb;
+	b2Vec2 center;
+	int32 nodeId;
+};
+
+struct b2BuildRange
+{
+	int32 begin;
+	int32 count;
+	int32 parent;
+	int32 child;
+
+	// Bounds the leaf centers in the range. It may be loose.
+	b2AABB centers;
+};
+
+// Choose a split of leaves[0, count) with the surface area heuristic, using
+// perimeter as the area, evaluated on bins along the longer axis of the leaf
+// centers. Reorders the leaves and returns how many are in the first part.
+// Also bounds the centers of each part, which saves the next split a pass.
+static int32 b2PartitionLeaves(b2BuildLeaf* leaves, int32 count, const b2AABB& centers,
+							   b2AABB* leftCenters, b2AABB* rightCenters)
+{
+	*leftCenters = centers;
+	*rightCenters = centers;
+
+	b2Vec2 lower = centers.lowerBound;
+	b2Vec2 upper = centers.upperBound;
+	int32 axis = upper.x - lower.x >= upper.y - lower.y ? 0 : 1;
+	float32 origin = lower(axis);
+	float32 extent = upper(axis) - origin;
+	if (extent <= b2_epsilon)
+	{
+		// The centers coincide, so any split is as good as another.
+		return count / 2;
+	}
+
+	float32 scale = b2_buildBinCount / extent;
+	b2BuildBin bins[b2_buildBinCount];
+	for (int32 i = 0; i < b2_buildBinCount; ++i)
+	{
+		bins[i].count = 0;
+	}
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		int32 bin = b2Min(int32((leaves[i].center(axis) - origin) * scale), b2_buildBinCount - 1);
+		const b2AABB& aabb = leaves[i].aabb;
+		if (bins[bin].count == 0)
+		{
+			bins[bin].aabb = aabb;
+		}
+		else
+		{
+			bins[bin].aabb.Combine(aabb);
+		}
+		++bins[bin].count;
+	}
+
+	// rightCost[i] is the cost of putting bins i and up in the second part.
+	// The bounds start empty so that combining the first bin copies it.
+	b2AABB empty;
+	empty.lowerBound.Set(b2_maxFloat, b2_maxFloat);
+	empty.upperBound.Set(-b2_maxFloat, -b2_maxFloat);
+
+	float32 rightCost[b2_buildBinCount];
+	b2AABB rightAABB = empty;
+	int32 rightCount = 0;
+	for (int32 i = b2_buildBinCount - 1; i > 0; --i)
+	{
+		if (bins[i].count > 0)
+		{
+			rightAABB.Combine(bins[i].aabb);
+			rightCount += bins[i].count;
+		}
+		rightCost[i] = rightCount > 0 ? rightCount * rightAABB.GetPerimeter() : 0.0f;
+	}
+
+	int32 split = 0;
+	float32 minCost = b2_maxFloat;
+	b2AABB leftAABB = empty;
+	int32 leftCount = 0;
+	for (int32 i = 0; i < b2_buildBinCount - 1; ++i)
+	{
+		if (bins[i].count > 0)
+		{
+			leftAABB.Combine(bins[i].aabb);
+			leftCount += bins[i].count;
+		}
+
+		if (leftCount == 0 || leftCount == count)
+		{
+			continue;
+		}
+
+		float32 cost = leftCount * leftAABB.GetPerimeter() + rightCost[i + 1];
+		if (cost < minCost)
+		{
+			minCost = cost;
+			split = i + 1;
+		}
+	}
+
+	if (split == 0)
+	{
+		return count / 2;
+	}
+
+	leftCenters->lowerBound.Set(b2_maxFloat, b2_maxFloat);
+	leftCenters->upperBound.Set(-b2_maxFloat, -b2_maxFloat);
+	*rightCenters = *leftCenters;
+
+	int32 i = 0;
+	int32 j = count - 1;
+	while (i <= j)
+	{
+		b2Vec2 center = leaves[i].center;
+		int32 bin = b2Min(int32((center(axis) - origin) * scale), b2_buildBinCount - 1);
+		if (bin < split)
+		{
+			leftCenters->lowerBound = b2Min(leftCenters->lowerBound, center);
+			leftCenters->upperBound = b2Max(leftCenters->upperBound, center);
+			++i;
+		}
+		else
+		{
+			rightCenters->lowerBound = b2Min(rightCenters->lowerBound, center);
+			rightCenters->upperBound = b2Max(rightCenters->upperBound, center);
+			b2Swap(leaves[i], leaves[j]);
+			--j;
+		}
+	}
+
+	return i;
+}
+
+// Build a subtree over the given leaves and return its root. The leaves are
+// reordered.
+int32 b2DynamicTree::BuildTopDown(b2BuildLeaf* leaves, int32 count)
+{
+	b2AABB centers;
+	centers.lowerBound = leaves[0].center;
+	centers.upperBound = leaves[0].center;
+	for (int32 i = 1; i < count; ++i)
+	{
+		centers.lowerBound = b2Min(centers.lowerBound, leaves[i].center);
+		centers.upperBound = b2Max(centers.upperBound, leaves[i].center);
+	}
+
+	int32* internalNodes = (int32*)b2Alloc(b2Max(count - 1, 1) * sizeof(int32));
+	int32 internalCount = 0;
+	int32 root = b2_nullNode;
+
+	b2GrowableStack<b2BuildRange, 256> stack;
+	b2BuildRange range;
+	range.begin = 0;
+	range.count = count;
+	range.parent = b2_nullNode;
+	range.child = 0;
+	range.centers = centers;
+	stack.Push(range);
+
+	while (stack.GetCount() > 0)
+	{
+		range = stack.Pop();
+
+		int32 nodeId;
+		if (range.count == 1)
+		{
+			nodeId = leaves[range.begin].nodeId;
+		}
+		else
+		{
+			nodeId = AllocateNode();
+			internalNodes[internalCount] = nodeId;
+			++internalCount;
+
+			b2BuildRange left;
+			b2BuildRange right;
+			int32 leftCount = b2PartitionLeaves(leaves + range.begin, range.count, range.centers,
+												&left.centers, &right.centers);
+
+			right.begin = range.begin + leftCount;
+			right.count = range.count - leftCount;
+			right.parent = nodeId;
+			right.child = 2;
+			stack.Push(right);
+
+			left.begin = range.begin;
+			left.count = leftCount;
+			left.parent = nodeId;
+			left.child = 1;
+			stack.Push(left);
+		}
+
+		m_nodes[nodeId].parent = range.parent;
+		if (range.parent == b2_nullNode)
+		{
+			root = nodeId;
+		}
+		else if (range.child == 1)
+		{
+			m_nodes[range.parent].child1 = nodeId;
+		}
+		else
+		{
+			m_nodes[range.parent].child2 = nodeId;
+		}
+	}
+
+	// Every internal node was created before its children, so walking them
+	// backwards fills in the bounds and heights bottom up.
+	for (int32 i = internalCount - 1; i >= 0; --i)
+	{
+		b2TreeNode* node = m_nodes + internalNodes[i];
+		const b2TreeNode* child1 = m_nodes + node->child1;
+		const b2TreeNode* child2 = m_nodes + node->child2;
+		node->aabb.Combine(child1->aabb, child2->aabb);
+		node->height = 1 + b2Max(child1->height, child2->height);
+	}
+
+	b2Free(internalNodes);
+	return root;
+}
+
+void b2DynamicTree::CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, int32* proxyIds)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	b2BuildLeaf* leaves = (b2BuildLeaf*)b2Alloc(count * sizeof(b2BuildLeaf));
+
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	for (int32 i = 0; i < count; ++i)
+	{
+		int32 proxyId = AllocateNode();
+		m_nodes[proxyId].aabb.lowerBound = aabbs[i].lowerBound - r;
+		m_nodes[proxyId].aabb.upperBound = aabbs[i].upperBound + r;
+		m_nodes[proxyId].userData = userData[i];
+		m_nodes[proxyId].height = 0;
+
+		proxyIds[i] = proxyId;
+		leaves[i].aabb = m_nodes[proxyId].aabb;
+		leaves[i].center = aabbs[i].GetCenter();
+		leaves[i].nodeId = proxyId;
+	}
+
+	int32 root = BuildTopDown(leaves, count);
+	InsertLeaf(root);
+
+	b2Free(leaves);
+}
+
 void b2DynamicTree::DestroyProxy(int32 proxyId)
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
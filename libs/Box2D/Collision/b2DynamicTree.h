@@ -50,6 +50,8 @@ struct b2TreeNode
 	int32 height;
 };
 
+struct b2BuildLeaf;
+
 /// A dynamic AABB tree broad-phase, inspired by Nathanael Presson's btDbvt.
 /// A dynamic tree arranges data in a binary tree to accelerate
 /// queries such as volume queries and ray casts. Leafs are proxies
@@ -70,6 +72,16 @@ public:
 	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
 	int32 CreateProxy(const b2AABB& aabb, void* userData);
 
+	/// Create many proxies at once. The new proxies are built into a subtree
+	/// top-down with a binned SAH split in O(n log n), and the subtree is then
+	/// inserted like a single leaf. This is much faster than calling CreateProxy
+	/// for each one, and for a large batch the tree quality is also better.
+	/// @param aabbs tight fitting AABBs, one per proxy.
+	/// @param userData one userData pointer per proxy.
+	/// @param count the number of proxies.
+	/// @param proxyIds receives the id of each new proxy.
+	void CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, int32* proxyIds);
+
 	/// Destroy a proxy. This asserts if the id is invalid.
 	void DestroyProxy(int32 proxyId);
 
@@ -131,6 +143,8 @@ private:
 	void InsertLeaf(int32 node);
 	void RemoveLeaf(int32 node);
 
+	int32 BuildTopDown(b2BuildLeaf* leaves, int32 count);
+
 	int32 Balance(int32 index);
 
 	int32 ComputeHeight() const;
@@ -147,6 +161,8 @@ private:
 
 	int32 m_freeList;
 
+	friend class b2WideTree;
+
 	/// This is used to incrementally traverse the tree for re-balancing.
 	uint32 m_path;
 
@@ -0,0 +1,371 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Collision/b2SweepAndPrune.h>
+#include <algorithm>
+#include <string.h>
+
+static bool b2SweepEntryLessThan(const b2SweepEntry& entryA, const b2SweepEntry& entryB)
+{
+	return entryA.aabb.lowerBound.x < entryB.aabb.lowerBound.x;
+}
+
+b2SweepAndPrune::b2SweepAndPrune()
+{
+	m_proxyCapacity = 16;
+	m_proxyCount = 0;
+	m_proxies = (b2SweepProxy*)b2Alloc(m_proxyCapacity * sizeof(b2SweepProxy));
+
+	// Build a linked list for the free list.
+	for (int32 i = 0; i < m_proxyCapacity - 1; ++i)
+	{
+		m_proxies[i].next = i + 1;
+	}
+	m_proxies[m_proxyCapacity-1].next = b2_nullNode;
+	m_freeList = 0;
+
+	m_entryCapacity = 16;
+	m_entryCount = 0;
+	m_entries = (b2SweepEntry*)b2Alloc(m_entryCapacity * sizeof(b2SweepEntry));
+
+	m_maxWidth = 0.0f;
+	m_maxWidthCount = 0;
+}
+
+b2SweepAndPrune::~b2SweepAndPrune()
+{
+	b2Free(m_entries);
+	b2Free(m_proxies);
+}
+
+// Allocate a proxy from the pool. Grow the pool if necessary.
+int32 b2SweepAndPrune::AllocateProxy()
+{
+	if (m_freeList == b2_nullNode)
+	{
+		b2Assert(m_proxyCount == m_proxyCapacity);
+
+		b2SweepProxy* oldProxies = m_proxies;
+		m_proxyCapacity *= 2;
+		m_proxies = (b2SweepProxy*)b2Alloc(m_proxyCapacity * sizeof(b2SweepProxy));
+		memcpy(m_proxies, oldProxies, m_proxyCount * sizeof(b2SweepProxy));
+		b2Free(oldProxies);
+
+		for (int32 i = m_proxyCount; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+		}
+		m_proxies[m_proxyCapacity-1].next = b2_nullNode;
+		m_freeList = m_proxyCount;
+	}
+
+	int32 proxyId = m_freeList;
+	m_freeList = m_proxies[proxyId].next;
+	m_proxies[proxyId].userData = NULL;
+	++m_proxyCount;
+	return proxyId;
+}
+
+// Return a proxy to the pool.
+void b2SweepAndPrune::FreeProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(0 < m_proxyCount);
+	m_proxies[proxyId].next = m_freeList;
+	m_freeList = proxyId;
+	--m_proxyCount;
+}
+
+void b2SweepAndPrune::ReserveEntries(int32 count)
+{
+	if (m_entryCapacity >= count)
+	{
+		return;
+	}
+
+	b2SweepEntry* oldEntries = m_entries;
+	m_entryCapacity = b2Max(count, 2 * m_entryCapacity);
+	m_entries = (b2SweepEntry*)b2Alloc(m_entryCapacity * sizeof(b2SweepEntry));
+	memcpy(m_entries, oldEntries, m_entryCount * sizeof(b2SweepEntry));
+	b2Free(oldEntries);
+}
+
+int32 b2SweepAndPrune::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	int32 proxyId = AllocateProxy();
+	m_proxies[proxyId].userData = userData;
+
+	// Fatten the aabb.
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	ReserveEntries(m_entryCount + 1);
+	b2SweepEntry* entry = m_entries + m_entryCount;
+	entry->aabb.lowerBound = aabb.lowerBound - r;
+	entry->aabb.upperBound = aabb.upperBound + r;
+	entry->proxyId = proxyId;
+	AddWidth(entry->aabb.upperBound.x - entry->aabb.lowerBound.x);
+
+	Shift(m_entryCount++);
+	return proxyId;
+}
+
+void b2SweepAndPrune::CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, int32* proxyIds)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Append the new entries, sort them and merge them into the rest.
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	ReserveEntries(m_entryCount + count);
+	b2SweepEntry* entries = m_entries + m_entryCount;
+	for (int32 i = 0; i < count; ++i)
+	{
+		int32 proxyId = AllocateProxy();
+		m_proxies[proxyId].userData = userData[i];
+		proxyIds[i] = proxyId;
+
+		entries[i].aabb.lowerBound = aabbs[i].lowerBound - r;
+		entries[i].aabb.upperBound = aabbs[i].upperBound + r;
+		entries[i].proxyId = proxyId;
+		AddWidth(entries[i].aabb.upperBound.x - entries[i].aabb.lowerBound.x);
+	}
+
+	std::sort(entries, entries + count, b2SweepEntryLessThan);
+	std::inplace_merge(m_entries, entries, entries + count, b2SweepEntryLessThan);
+	m_entryCount += count;
+
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		if (m_entries[i].proxyId != b2_nullNode)
+		{
+			m_proxies[m_entries[i].proxyId].index = i;
+		}
+	}
+}
+
+void b2SweepAndPrune::DestroyProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+
+	// The entry keeps its place in the order until the next compaction, so
+	// that destroying does not move the rest of the array.
+	b2SweepEntry* entry = m_entries + m_proxies[proxyId].index;
+	entry->proxyId = b2_nullNode;
+	FreeProxy(proxyId);
+	RemoveWidth(entry->aabb.upperBound.x - entry->aabb.lowerBound.x);
+
+	if (2 * m_proxyCount < m_entryCount)
+	{
+		Compact();
+	}
+}
+
+bool b2SweepAndPrune::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+
+	int32 index = m_proxies[proxyId].index;
+	b2SweepEntry* entry = m_entries + index;
+	if (entry->aabb.Contains(aabb))
+	{
+		return false;
+	}
+
+	// Extend AABB.
+	b2AABB b = aabb;
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b.lowerBound = b.lowerBound - r;
+	b.upperBound = b.upperBound + r;
+
+	// Predict AABB displacement.
+	b2Vec2 d = b2_aabbMultiplier * displacement;
+
+	if (d.x < 0.0f)
+	{
+		b.lowerBound.x += d.x;
+	}
+	else
+	{
+		b.upperBound.x += d.x;
+	}
+
+	if (d.y < 0.0f)
+	{
+		b.lowerBound.y += d.y;
+	}
+	else
+	{
+		b.upperBound.y += d.y;
+	}
+
+	float32 oldWidth = entry->aabb.upperBound.x - entry->aabb.lowerBound.x;
+	entry->aabb = b;
+	AddWidth(b.upperBound.x - b.lowerBound.x);
+	RemoveWidth(oldWidth);
+
+	Shift(index);
+	return true;
+}
+
+// Insertion sort step for the entry at index, whose lower bound changed.
+void b2SweepAndPrune::Shift(int32 index)
+{
+	b2SweepEntry entry = m_entries[index];
+	float32 x = entry.aabb.lowerBound.x;
+
+	while (index > 0 && m_entries[index - 1].aabb.lowerBound.x > x)
+	{
+		m_entries[index] = m_entries[index - 1];
+		if (m_entries[index].proxyId != b2_nullNode)
+		{
+			m_proxies[m_entries[index].proxyId].index = index;
+		}
+		--index;
+	}
+
+	while (index + 1 < m_entryCount && m_entries[index + 1].aabb.lowerBound.x < x)
+	{
+		m_entries[index] = m_entries[index + 1];
+		if (m_entries[index].proxyId != b2_nullNode)
+		{
+			m_proxies[m_entries[index].proxyId].index = index;
+		}
+		++index;
+	}
+
+	m_entries[index] = entry;
+	m_proxies[entry.proxyId].index = index;
+}
+
+// Drop the entries of destroyed proxies.
+void b2SweepAndPrune::Compact()
+{
+	int32 count = 0;
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		const b2SweepEntry& entry = m_entries[i];
+		if (entry.proxyId == b2_nullNode)
+		{
+			continue;
+		}
+
+		m_entries[count] = entry;
+		m_proxies[entry.proxyId].index = count;
+		++count;
+	}
+	m_entryCount = count;
+}
+
+void b2SweepAndPrune::AddWidth(float32 width)
+{
+	if (width > m_maxWidth)
+	{
+		m_maxWidth = width;
+		m_maxWidthCount = 1;
+	}
+	else if (width == m_maxWidth)
+	{
+		++m_maxWidthCount;
+	}
+}
+
+// Call after the entry no longer has this width, so that measuring again
+// does not count it.
+void b2SweepAndPrune::RemoveWidth(float32 width)
+{
+	if (width < m_maxWidth)
+	{
+		return;
+	}
+
+	b2Assert(width == m_maxWidth && m_maxWidthCount > 0);
+	--m_maxWidthCount;
+	if (m_maxWidthCount == 0)
+	{
+		ComputeMaxWidth();
+	}
+}
+
+void b2SweepAndPrune::ComputeMaxWidth()
+{
+	m_maxWidth = 0.0f;
+	m_maxWidthCount = 0;
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		const b2SweepEntry& entry = m_entries[i];
+		if (entry.proxyId != b2_nullNode)
+		{
+			AddWidth(entry.aabb.upperBound.x - entry.aabb.lowerBound.x);
+		}
+	}
+}
+
+void b2SweepAndPrune::Validate() const
+{
+	int32 liveCount = 0;
+	int32 maxWidthCount = 0;
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		const b2SweepEntry& entry = m_entries[i];
+		if (i > 0)
+		{
+			b2Assert(m_entries[i - 1].aabb.lowerBound.x <= entry.aabb.lowerBound.x);
+		}
+
+		if (entry.proxyId == b2_nullNode)
+		{
+			continue;
+		}
+
+		b2Assert(0 <= entry.proxyId && entry.proxyId < m_proxyCapacity);
+		b2Assert(m_proxies[entry.proxyId].index == i);
+		float32 width = entry.aabb.upperBound.x - entry.aabb.lowerBound.x;
+		b2Assert(width <= m_maxWidth);
+		if (width == m_maxWidth)
+		{
+			++maxWidthCount;
+		}
+		++liveCount;
+	}
+
+	b2Assert(liveCount == m_proxyCount);
+	b2Assert(maxWidthCount == m_maxWidthCount);
+
+	int32 freeCount = 0;
+	int32 freeIndex = m_freeList;
+	while (freeIndex != b2_nullNode)
+	{
+		b2Assert(0 <= freeIndex && freeIndex < m_proxyCapacity);
+		freeIndex = m_proxies[freeIndex].next;
+		++freeCount;
+	}
+
+	b2Assert(liveCount + freeCount == m_proxyCapacity);
+}
+
+void b2SweepAndPrune::ShiftOrigin(const b2Vec2& newOrigin)
+{
+	// Shifting every entry by the same amount keeps the order.
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		m_entries[i].aabb.lowerBound -= newOrigin;
+		m_entries[i].aabb.upperBound -= newOrigin;
+	}
+
+	// Rounding can change the widths slightly.
+	ComputeMaxWidth();
+}
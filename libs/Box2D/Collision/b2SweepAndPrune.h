@@ -0,0 +1,269 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_SWEEP_AND_PRUNE_H
+#define B2_SWEEP_AND_PRUNE_H
+
+#include <Box2D/Collision/b2DynamicTree.h>
+
+/// A proxy of the sweep and prune. While the proxy is in use, index is its
+/// position in the sorted array. Otherwise it links the free list.
+struct b2SweepProxy
+{
+	void* userData;
+
+	union
+	{
+		int32 index;
+		int32 next;
+	};
+};
+
+/// An element of the sorted array. The fat AABB is kept here rather than in
+/// the proxy so that the sweep reads memory in order. Destroyed proxies
+/// leave their entry behind with a null proxy id until the next compaction.
+struct b2SweepEntry
+{
+	b2AABB aabb;
+	int32 proxyId;
+};
+
+/// Keeps fat AABBs sorted by their lower x bound, the sort and sweep of a
+/// single axis. A moved proxy is shifted to its new place in the array, which
+/// with coherent motion is a few places at most, so moving costs about the
+/// same for every proxy no matter how many there are. A query sweeps the
+/// entries whose lower bound lies between the query's lower bound minus the
+/// widest proxy and its upper bound.
+///
+/// This suits many similarly sized proxies spread along x, such as the
+/// bullets and debris of a side scrolling level. One very wide proxy makes
+/// every query sweep further, and a level stacked along y puts many proxies
+/// in each sweep; use b2DynamicTree there.
+///
+/// Proxy ids, fattening and MoveProxy follow b2DynamicTree, so the two can
+/// stand in for each other.
+class b2SweepAndPrune
+{
+public:
+	b2SweepAndPrune();
+	~b2SweepAndPrune();
+
+	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
+
+	/// Create many proxies at once with a single sort.
+	/// @param proxyIds receives the id of each new proxy.
+	void CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, int32* proxyIds);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int32 proxyId);
+
+	/// Same as b2DynamicTree::MoveProxy.
+	/// @return true if the proxy was re-fattened.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
+
+	/// Get proxy user data.
+	void* GetUserData(int32 proxyId) const;
+
+	/// Get the fat AABB for a proxy.
+	const b2AABB& GetFatAABB(int32 proxyId) const;
+
+	/// Same as b2DynamicTree::Query. Proxies are reported by lower x bound.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Same as b2DynamicTree::RayCast. Proxies are reported by lower x bound.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Get the number of proxies.
+	int32 GetProxyCount() const;
+
+	/// Validate the sort order and the proxy indices. For testing.
+	void Validate() const;
+
+	/// Shift the world origin. Useful for large worlds.
+	/// The shift formula is: position -= newOrigin
+	/// @param newOrigin the new origin with respect to the old origin
+	void ShiftOrigin(const b2Vec2& newOrigin);
+
+private:
+
+	int32 AllocateProxy();
+	void FreeProxy(int32 proxyId);
+
+	void ReserveEntries(int32 count);
+	void Shift(int32 index);
+	void Compact();
+
+	// Track the widest entry as entries are added, resized and removed.
+	void AddWidth(float32 width);
+	void RemoveWidth(float32 width);
+	void ComputeMaxWidth();
+
+	// Index of the first entry with a lower x bound of at least x.
+	int32 FindLowerBound(float32 x) const;
+
+	b2SweepProxy* m_proxies;
+	int32 m_proxyCapacity;
+	int32 m_proxyCount;
+	int32 m_freeList;
+
+	b2SweepEntry* m_entries;
+	int32 m_entryCapacity;
+	int32 m_entryCount;
+
+	// The widest live fat AABB along x, and how many entries are that wide.
+	// When the last of them shrinks or is destroyed the width is measured
+	// again, so one transient wide proxy does not slow every later sweep.
+	float32 m_maxWidth;
+	int32 m_maxWidthCount;
+};
+
+inline void* b2SweepAndPrune::GetUserData(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline const b2AABB& b2SweepAndPrune::GetFatAABB(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_entries[m_proxies[proxyId].index].aabb;
+}
+
+inline int32 b2SweepAndPrune::GetProxyCount() const
+{
+	return m_proxyCount;
+}
+
+inline int32 b2SweepAndPrune::FindLowerBound(float32 x) const
+{
+	int32 low = 0;
+	int32 high = m_entryCount;
+	while (low < high)
+	{
+		int32 mid = (low + high) >> 1;
+		if (m_entries[mid].aabb.lowerBound.x < x)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+template <typename T>
+inline void b2SweepAndPrune::Query(T* callback, const b2AABB& aabb) const
+{
+	for (int32 i = FindLowerBound(aabb.lowerBound.x - m_maxWidth); i < m_entryCount; ++i)
+	{
+		const b2SweepEntry* entry = m_entries + i;
+		if (entry->aabb.lowerBound.x > aabb.upperBound.x)
+		{
+			break;
+		}
+
+		if (entry->proxyId == b2_nullNode || b2TestOverlap(entry->aabb, aabb) == false)
+		{
+			continue;
+		}
+
+		bool proceed = callback->QueryCallback(entry->proxyId);
+		if (proceed == false)
+		{
+			return;
+		}
+	}
+}
+
+template <typename T>
+inline void b2SweepAndPrune::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	float32 maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	for (int32 i = FindLowerBound(segmentAABB.lowerBound.x - m_maxWidth); i < m_entryCount; ++i)
+	{
+		const b2SweepEntry* entry = m_entries + i;
+
+		// Clipping the ray can only pull this bound in, so the sweep may
+		// stop early.
+		if (entry->aabb.lowerBound.x > segmentAABB.upperBound.x)
+		{
+			break;
+		}
+
+		if (entry->proxyId == b2_nullNode || b2TestOverlap(entry->aabb, segmentAABB) == false)
+		{
+			continue;
+		}
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2Vec2 c = entry->aabb.GetCenter();
+		b2Vec2 h = entry->aabb.GetExtents();
+		float32 separation = b2Abs(b2Dot(v, p1 - c)) - b2Dot(abs_v, h);
+		if (separation > 0.0f)
+		{
+			continue;
+		}
+
+		b2RayCastInput subInput;
+		subInput.p1 = input.p1;
+		subInput.p2 = input.p2;
+		subInput.maxFraction = maxFraction;
+
+		float32 value = callback->RayCastCallback(subInput, entry->proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			// Update segment bounding box.
+			maxFraction = value;
+			b2Vec2 t = p1 + maxFraction * (p2 - p1);
+			segmentAABB.lowerBound = b2Min(p1, t);
+			segmentAABB.upperBound = b2Max(p1, t);
+		}
+	}
+}
+
+#endif
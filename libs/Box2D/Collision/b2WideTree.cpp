@@ -0,0 +1,131 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Collision/b2WideTree.h>
+
+b2WideTree::b2WideTree()
+{
+	m_nodeCapacity = 0;
+	m_nodeCount = 0;
+	m_nodes = NULL;
+}
+
+b2WideTree::~b2WideTree()
+{
+	b2Free(m_nodes);
+}
+
+void b2WideTree::Clear()
+{
+	m_nodeCount = 0;
+}
+
+void b2WideTree::Build(const b2DynamicTree& tree)
+{
+	m_nodeCount = 0;
+	if (tree.m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	// Every wide node takes the place of at least one binary node, so this
+	// is enough and the array never moves during the build.
+	if (m_nodeCapacity < tree.m_nodeCount)
+	{
+		b2Free(m_nodes);
+		m_nodeCapacity = b2Max(tree.m_nodeCount, 2 * m_nodeCapacity);
+		m_nodes = (b2WideTreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2WideTreeNode));
+	}
+
+	BuildNode(tree.m_nodes, tree.m_root);
+}
+
+// Creates the wide node for the binary subtree at nodeId, followed by the
+// nodes of its descendants, and returns its index.
+int32 b2WideTree::BuildNode(const b2TreeNode* nodes, int32 nodeId)
+{
+	int32 index = m_nodeCount++;
+
+	// Open up the binary tree below nodeId until there are four children,
+	// always splitting the largest internal one.
+	int32 children[b2_simdWidth];
+	int32 count = 0;
+	if (nodes[nodeId].IsLeaf())
+	{
+		// Only happens at the root of a tree with one proxy.
+		children[count++] = nodeId;
+	}
+	else
+	{
+		children[count++] = nodes[nodeId].child1;
+		children[count++] = nodes[nodeId].child2;
+	}
+
+	while (count < b2_simdWidth)
+	{
+		int32 best = -1;
+		float32 bestPerimeter = -1.0f;
+		for (int32 i = 0; i < count; ++i)
+		{
+			const b2TreeNode* child = nodes + children[i];
+			if (child->IsLeaf() == false && child->aabb.GetPerimeter() > bestPerimeter)
+			{
+				best = i;
+				bestPerimeter = child->aabb.GetPerimeter();
+			}
+		}
+
+		if (best < 0)
+		{
+			break;
+		}
+
+		const b2TreeNode* split = nodes + children[best];
+		children[best] = split->child1;
+		children[count++] = split->child2;
+	}
+
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		b2WideTreeNode* node = m_nodes + index;
+		if (lane >= count)
+		{
+			node->lowerX[lane] = b2_maxFloat;
+			node->lowerY[lane] = b2_maxFloat;
+			node->upperX[lane] = -b2_maxFloat;
+			node->upperY[lane] = -b2_maxFloat;
+			node->children[lane] = b2_nullNode;
+			continue;
+		}
+
+		const b2TreeNode* child = nodes + children[lane];
+		node->lowerX[lane] = child->aabb.lowerBound.x;
+		node->lowerY[lane] = child->aabb.lowerBound.y;
+		node->upperX[lane] = child->aabb.upperBound.x;
+		node->upperY[lane] = child->aabb.upperBound.y;
+
+		if (child->IsLeaf())
+		{
+			node->children[lane] = ~children[lane];
+		}
+		else
+		{
+			node->children[lane] = BuildNode(nodes, children[lane]);
+		}
+	}
+
+	return index;
+}
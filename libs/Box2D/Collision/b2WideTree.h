@@ -0,0 +1,236 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_WIDE_TREE_H
+#define B2_WIDE_TREE_H
+
+#include <Box2D/Collision/b2DynamicTree.h>
+#include <Box2D/Common/b2SIMD.h>
+
+/// A node of the wide tree with the bounds of up to b2_simdWidth children,
+/// one per lane. A child is a node index if it is >= 0 and ~proxyId for a
+/// leaf. Unused lanes have empty bounds that overlap nothing.
+struct b2WideTreeNode
+{
+	float32 lowerX[b2_simdWidth];
+	float32 lowerY[b2_simdWidth];
+	float32 upperX[b2_simdWidth];
+	float32 upperY[b2_simdWidth];
+	int32 children[b2_simdWidth];
+};
+
+/// A read-only copy of a b2DynamicTree laid out for fast queries. Each node
+/// holds up to four children, which are tested against a query together,
+/// and nodes are stored in depth first order. Proxy ids are those of the
+/// source tree, so user data and fat AABBs are still looked up there.
+///
+/// The copy does not follow changes to the source tree. Call Build again
+/// after proxies are created, destroyed or moved.
+class b2WideTree
+{
+public:
+	b2WideTree();
+	~b2WideTree();
+
+	/// Rebuild from tree. This takes time linear in the tree size.
+	void Build(const b2DynamicTree& tree);
+
+	/// Remove all nodes.
+	void Clear();
+
+	/// Same as b2DynamicTree::Query, though proxies may be reported in a
+	/// different order.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Same as b2DynamicTree::RayCast, though proxies may be reported in a
+	/// different order.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Get the number of nodes.
+	int32 GetNodeCount() const;
+
+private:
+
+	int32 BuildNode(const b2TreeNode* nodes, int32 nodeId);
+
+	b2WideTreeNode* m_nodes;
+	int32 m_nodeCount;
+	int32 m_nodeCapacity;
+};
+
+inline int32 b2WideTree::GetNodeCount() const
+{
+	return m_nodeCount;
+}
+
+template <typename T>
+inline void b2WideTree::Query(T* callback, const b2AABB& aabb) const
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	b2FloatW lowerX = b2SplatW(aabb.lowerBound.x);
+	b2FloatW lowerY = b2SplatW(aabb.lowerBound.y);
+	b2FloatW upperX = b2SplatW(aabb.upperBound.x);
+	b2FloatW upperY = b2SplatW(aabb.upperBound.y);
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(0);
+
+	while (stack.GetCount() > 0)
+	{
+		const b2WideTreeNode* node = m_nodes + stack.Pop();
+
+		b2MaskW overlapX = b2AndW(b2GreaterEqualW(upperX, b2LoadW(node->lowerX)), b2GreaterEqualW(b2LoadW(node->upperX), lowerX));
+		b2MaskW overlapY = b2AndW(b2GreaterEqualW(upperY, b2LoadW(node->lowerY)), b2GreaterEqualW(b2LoadW(node->upperY), lowerY));
+		int32 overlaps = b2MoveMaskW(b2AndW(overlapX, overlapY));
+
+		// Push in reverse so the first child is visited first.
+		for (int32 lane = b2_simdWidth - 1; lane >= 0; --lane)
+		{
+			if ((overlaps & (1 << lane)) == 0)
+			{
+				continue;
+			}
+
+			int32 child = node->children[lane];
+			if (child >= 0)
+			{
+				stack.Push(child);
+				continue;
+			}
+
+			bool proceed = callback->QueryCallback(~child);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+	}
+}
+
+template <typename T>
+inline void b2WideTree::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	b2FloatW p1x = b2SplatW(p1.x);
+	b2FloatW p1y = b2SplatW(p1.y);
+	b2FloatW vx = b2SplatW(v.x);
+	b2FloatW vy = b2SplatW(v.y);
+	b2FloatW absVx = b2SplatW(abs_v.x);
+	b2FloatW absVy = b2SplatW(abs_v.y);
+	b2FloatW half = b2SplatW(0.5f);
+	b2FloatW zero = b2ZeroW();
+
+	float32 maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2FloatW segmentLowerX, segmentLowerY, segmentUpperX, segmentUpperY;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentLowerX = b2SplatW(b2Min(p1.x, t.x));
+		segmentLowerY = b2SplatW(b2Min(p1.y, t.y));
+		segmentUpperX = b2SplatW(b2Max(p1.x, t.x));
+		segmentUpperY = b2SplatW(b2Max(p1.y, t.y));
+	}
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(0);
+
+	while (stack.GetCount() > 0)
+	{
+		const b2WideTreeNode* node = m_nodes + stack.Pop();
+
+		b2FloatW lowerX = b2LoadW(node->lowerX);
+		b2FloatW lowerY = b2LoadW(node->lowerY);
+		b2FloatW upperX = b2LoadW(node->upperX);
+		b2FloatW upperY = b2LoadW(node->upperY);
+
+		b2MaskW overlapX = b2AndW(b2GreaterEqualW(segmentUpperX, lowerX), b2GreaterEqualW(upperX, segmentLowerX));
+		b2MaskW overlapY = b2AndW(b2GreaterEqualW(segmentUpperY, lowerY), b2GreaterEqualW(upperY, segmentLowerY));
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2FloatW cx = half * (lowerX + upperX);
+		b2FloatW cy = half * (lowerY + upperY);
+		b2FloatW hx = half * (upperX - lowerX);
+		b2FloatW hy = half * (upperY - lowerY);
+		b2FloatW separation = b2AbsW(vx * (p1x - cx) + vy * (p1y - cy)) - (absVx * hx + absVy * hy);
+		b2MaskW touching = b2GreaterEqualW(zero, separation);
+
+		int32 hits = b2MoveMaskW(b2AndW(b2AndW(overlapX, overlapY), touching));
+
+		for (int32 lane = b2_simdWidth - 1; lane >= 0; --lane)
+		{
+			if ((hits & (1 << lane)) == 0)
+			{
+				continue;
+			}
+
+			int32 child = node->children[lane];
+			if (child >= 0)
+			{
+				stack.Push(child);
+				continue;
+			}
+
+			b2RayCastInput subInput;
+			subInput.p1 = input.p1;
+			subInput.p2 = input.p2;
+			subInput.maxFraction = maxFraction;
+
+			float32 value = callback->RayCastCallback(subInput, ~child);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (value > 0.0f)
+			{
+				// Update segment bounding box. Lanes of this node already
+				// accepted may no longer be hit; the callback clips them.
+				maxFraction = value;
+				b2Vec2 t = p1 + maxFraction * (p2 - p1);
+				segmentLowerX = b2SplatW(b2Min(p1.x, t.x));
+				segmentLowerY = b2SplatW(b2Min(p1.y, t.y));
+				segmentUpperX = b2SplatW(b2Max(p1.x, t.x));
+				segmentUpperY = b2SplatW(b2Max(p1.y, t.y));
+			}
+		}
+	}
+}
+
+#endif
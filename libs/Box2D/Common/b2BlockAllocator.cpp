@@ -52,6 +52,22 @@ struct b2Block
 	b2Block* next;
 };
 
+// Fill in the byte counts and the chunk total from the per class counts.
+static void b2FinishStats(b2BlockAllocatorStats* stats)
+{
+	stats->chunkCount = 0;
+	stats->freeBytes = 0;
+	for (int32 i = 0; i < b2_blockSizes; ++i)
+	{
+		int32 blockSize = b2BlockAllocator::GetBlockSize(i);
+		int32 blockCount = stats->chunks[i] * (b2_chunkSize / blockSize);
+		stats->chunkCount += stats->chunks[i];
+		stats->freeBytes += (blockCount - stats->liveBlocks[i]) * blockSize;
+	}
+
+	stats->wastedBytes = stats->chunkCount * b2_chunkSize - stats->freeBytes - stats->liveBytes;
+}
+
 b2BlockAllocator::b2BlockAllocator()
 {
 	b2Assert(b2_blockSizes < UCHAR_MAX);
@@ -63,6 +79,12 @@ b2BlockAllocator::b2BlockAllocator()
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
 
+	memset(m_liveBlocks, 0, sizeof(m_liveBlocks));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+	m_liveBytes = 0;
+	m_largeCount = 0;
+	m_largeBytes = 0;
+
 	if (s_blockSizeLookupInitialized == false)
 	{
 		int32 j = 0;
@@ -103,12 +125,17 @@ void* b2BlockAllocator::Allocate(int32 size)
 
 	if (size > b2_maxBlockSize)
 	{
+		++m_largeCount;
+		m_largeBytes += size;
 		return b2Alloc(size);
 	}
 
 	int32 index = s_blockSizeLookup[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
 
+	++m_liveBlocks[index];
+	m_liveBytes += size;
+
 	if (m_freeLists[index])
 	{
 		b2Block* block = m_freeLists[index];
@@ -147,6 +174,7 @@ void* b2BlockAllocator::Allocate(int32 size)
 
 		m_freeLists[index] = chunk->blocks->next;
 		++m_chunkCount;
+		++m_chunkCounts[index];
 
 		return chunk->blocks;
 	}
@@ -163,6 +191,8 @@ void b2BlockAllocator::Free(void* p, int32 size)
 
 	if (size > b2_maxBlockSize)
 	{
+		--m_largeCount;
+		m_largeBytes -= size;
 		b2Free(p);
 		return;
 	}
@@ -170,6 +200,9 @@ void b2BlockAllocator::Free(void* p, int32 size)
 	int32 index = s_blockSizeLookup[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
 
+	--m_liveBlocks[index];
+	m_liveBytes -= size;
+
 #ifdef _DEBUG
 	// Verify the memory address and size is valid.
 	int32 blockSize = s_blockSizes[index];
@@ -212,4 +245,173 @@ void b2BlockAllocator::Clear()
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+
+	memset(m_liveBlocks, 0, sizeof(m_liveBlocks));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+	m_liveBytes = 0;
+	m_largeCount = 0;
+	m_largeBytes = 0;
+}
+
+void b2BlockAllocator::GetStats(b2BlockAllocatorStats* stats) const
+{
+	memcpy(stats->liveBlocks, m_liveBlocks, sizeof(m_liveBlocks));
+	memcpy(stats->chunks, m_chunkCounts, sizeof(m_chunkCounts));
+	stats->liveBytes = m_liveBytes;
+	stats->largeCount = m_largeCount;
+	stats->largeBytes = m_largeBytes;
+	b2FinishStats(stats);
+}
+
+int32 b2BlockAllocator::GetBlockSize(int32 sizeClass)
+{
+	b2Assert(0 <= sizeClass && sizeClass < b2_blockSizes);
+	return s_blockSizes[sizeClass];
+}
+
+b2ThreadBlockAllocator::b2ThreadBlockAllocator(int32 threadCount)
+{
+	b2Assert(0 < threadCount);
+	m_threadCount = threadCount;
+	m_caches = (b2ThreadCache*)b2Alloc(m_threadCount * sizeof(b2ThreadCache));
+	memset(m_caches, 0, m_threadCount * sizeof(b2ThreadCache));
+}
+
+b2ThreadBlockAllocator::~b2ThreadBlockAllocator()
+{
+	// The cached blocks belong to the chunks of m_shared, which frees them.
+	b2Free(m_caches);
+}
+
+void* b2ThreadBlockAllocator::Allocate(int32 size, int32 threadIndex)
+{
+	if (size == 0)
+		return NULL;
+
+	b2Assert(0 < size);
+	b2Assert(0 <= threadIndex && threadIndex < m_threadCount);
+	b2ThreadCache* cache = m_caches + threadIndex;
+
+	if (size > b2_maxBlockSize)
+	{
+		++cache->largeCount;
+		cache->largeBytes += size;
+		return b2Alloc(size);
+	}
+
+	int32 index = b2BlockAllocator::s_blockSizeLookup[size];
+	if (cache->freeLists[index] == NULL)
+	{
+		Refill(cache, index);
+	}
+
+	b2Block* block = cache->freeLists[index];
+	cache->freeLists[index] = block->next;
+	--cache->freeCounts[index];
+
+	++cache->liveBlocks[index];
+	cache->liveBytes += size;
+	return block;
+}
+
+void b2ThreadBlockAllocator::Free(void* p, int32 size, int32 threadIndex)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	b2Assert(0 < size);
+	b2Assert(0 <= threadIndex && threadIndex < m_threadCount);
+	b2ThreadCache* cache = m_caches + threadIndex;
+
+	if (size > b2_maxBlockSize)
+	{
+		--cache->largeCount;
+		cache->largeBytes -= size;
+		b2Free(p);
+		return;
+	}
+
+	int32 index = b2BlockAllocator::s_blockSizeLookup[size];
+	b2Block* block = (b2Block*)p;
+	block->next = cache->freeLists[index];
+	cache->freeLists[index] = block;
+	++cache->freeCounts[index];
+
+	--cache->liveBlocks[index];
+	cache->liveBytes -= size;
+
+	// Keep a batch for the next allocations and give the rest back, so that
+	// a thread that only frees does not hoard blocks.
+	if (cache->freeCounts[index] >= 2 * b2_threadCacheBatch)
+	{
+		Return(cache, index, b2_threadCacheBatch);
+	}
+}
+
+void b2ThreadBlockAllocator::Flush(int32 threadIndex)
+{
+	b2Assert(0 <= threadIndex && threadIndex < m_threadCount);
+	b2ThreadCache* cache = m_caches + threadIndex;
+	for (int32 i = 0; i < b2_blockSizes; ++i)
+	{
+		if (cache->freeCounts[i] > 0)
+		{
+			Return(cache, i, cache->freeCounts[i]);
+		}
+	}
+}
+
+void b2ThreadBlockAllocator::Refill(b2ThreadCache* cache, int32 sizeClass)
+{
+	int32 blockSize = b2BlockAllocator::s_blockSizes[sizeClass];
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (int32 i = 0; i < b2_threadCacheBatch; ++i)
+	{
+		b2Block* block = (b2Block*)m_shared.Allocate(blockSize);
+		block->next = cache->freeLists[sizeClass];
+		cache->freeLists[sizeClass] = block;
+	}
+	cache->freeCounts[sizeClass] += b2_threadCacheBatch;
+}
+
+void b2ThreadBlockAllocator::Return(b2ThreadCache* cache, int32 sizeClass, int32 count)
+{
+	int32 blockSize = b2BlockAllocator::s_blockSizes[sizeClass];
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Block* block = cache->freeLists[sizeClass];
+		cache->freeLists[sizeClass] = block->next;
+		m_shared.Free(block, blockSize);
+	}
+	cache->freeCounts[sizeClass] -= count;
+}
+
+void b2ThreadBlockAllocator::GetStats(b2BlockAllocatorStats* stats) const
+{
+	// The shared pool counts the blocks held by the caches as in use, so
+	// only its chunk counts are taken.
+	m_shared.GetStats(stats);
+
+	memset(stats->liveBlocks, 0, sizeof(stats->liveBlocks));
+	stats->liveBytes = 0;
+	stats->largeCount = 0;
+	stats->largeBytes = 0;
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		const b2ThreadCache* cache = m_caches + i;
+		for (int32 j = 0; j < b2_blockSizes; ++j)
+		{
+			stats->liveBlocks[j] += cache->liveBlocks[j];
+		}
+		stats->liveBytes += cache->liveBytes;
+		stats->largeCount += cache->largeCount;
+		stats->largeBytes += cache->largeBytes;
+	}
+
+	b2FinishStats(stats);
 }
@@ -21,14 +21,35 @@
 
 #include <Box2D/Common/b2Settings.h>
 
+#include <mutex>
+
 const int32 b2_chunkSize = 16 * 1024;
 const int32 b2_maxBlockSize = 640;
 const int32 b2_blockSizes = 14;
 const int32 b2_chunkArrayIncrement = 128;
 
+/// A b2ThreadBlockAllocator moves blocks between a thread and the shared pool
+/// this many at a time.
+const int32 b2_threadCacheBatch = 32;
+
 struct b2Block;
 struct b2Chunk;
 
+/// Usage counters of a block allocator, to help tune b2_chunkSize and the
+/// block sizes for a game's content. Every chunk byte is counted in exactly
+/// one of liveBytes, freeBytes and wastedBytes.
+struct b2BlockAllocatorStats
+{
+	int32 liveBlocks[b2_blockSizes];	///< blocks in use, per size class
+	int32 chunks[b2_blockSizes];		///< chunks, per size class
+	int32 chunkCount;					///< all chunks, b2_chunkSize bytes each
+	int32 liveBytes;					///< bytes asked for by the blocks in use
+	int32 freeBytes;					///< bytes in free blocks
+	int32 wastedBytes;					///< rounding up to the block size, and chunk tails
+	int32 largeCount;					///< live allocations over b2_maxBlockSize, which use b2Alloc
+	int32 largeBytes;					///< bytes of those allocations
+};
+
 /// This is a small object allocator used for allocating small
 /// objects that persist for more than one time step.
 /// See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
@@ -46,17 +67,94 @@ public:
 
 	void Clear();
 
+	/// Get the usage counters.
+	void GetStats(b2BlockAllocatorStats* stats) const;
+
+	/// Get the size of the blocks of a size class.
+	static int32 GetBlockSize(int32 sizeClass);
+
 private:
 
+	friend class b2ThreadBlockAllocator;
+
 	b2Chunk* m_chunks;
 	int32 m_chunkCount;
 	int32 m_chunkSpace;
 
 	b2Block* m_freeLists[b2_blockSizes];
 
+	int32 m_liveBlocks[b2_blockSizes];
+	int32 m_chunkCounts[b2_blockSizes];
+	int32 m_liveBytes;
+	int32 m_largeCount;
+	int32 m_largeBytes;
+
 	static int32 s_blockSizes[b2_blockSizes];
 	static uint8 s_blockSizeLookup[b2_maxBlockSize + 1];
 	static bool s_blockSizeLookupInitialized;
 };
 
+/// A b2BlockAllocator that can be used from several threads at once. Each
+/// thread has its own free lists and only takes the lock of the shared pool
+/// to take or return b2_threadCacheBatch blocks at a time. Blocks may be
+/// freed by a different thread than the one that allocated them.
+///
+/// Threads are identified by index, like the threadIndex passed to
+/// b2Task::Execute. Two threads must never use the same index at once.
+class b2ThreadBlockAllocator
+{
+public:
+	/// @param threadCount the number of thread indices, see
+	/// b2TaskExecutor::GetThreadCount.
+	b2ThreadBlockAllocator(int32 threadCount);
+	~b2ThreadBlockAllocator();
+
+	/// Allocate memory on behalf of thread threadIndex.
+	void* Allocate(int32 size, int32 threadIndex);
+
+	/// Free memory on behalf of thread threadIndex.
+	void Free(void* p, int32 size, int32 threadIndex);
+
+	/// Return every block cached by thread threadIndex to the shared pool.
+	void Flush(int32 threadIndex);
+
+	/// Get the usage counters of all threads together. Do not call this
+	/// while any thread is allocating or freeing.
+	void GetStats(b2BlockAllocatorStats* stats) const;
+
+	int32 GetThreadCount() const;
+
+private:
+
+	struct b2ThreadCache
+	{
+		b2Block* freeLists[b2_blockSizes];
+		int32 freeCounts[b2_blockSizes];
+
+		// What this thread allocated minus what it freed. A thread that
+		// frees blocks of another thread goes negative, the sum does not.
+		int32 liveBlocks[b2_blockSizes];
+		int32 liveBytes;
+		int32 largeCount;
+		int32 largeBytes;
+
+		// Keeps the caches of two threads off the same cache line.
+		int8 padding[64];
+	};
+
+	void Refill(b2ThreadCache* cache, int32 sizeClass);
+	void Return(b2ThreadCache* cache, int32 sizeClass, int32 count);
+
+	b2BlockAllocator m_shared;
+	std::mutex m_mutex;
+
+	b2ThreadCache* m_caches;
+	int32 m_threadCount;
+};
+
+inline int32 b2ThreadBlockAllocator::GetThreadCount() const
+{
+	return m_threadCount;
+}
+
 #endif
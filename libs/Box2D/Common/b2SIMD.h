@@ -0,0 +1,276 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_SIMD_H
+#define B2_SIMD_H
+
+#include <Box2D/Common/b2Settings.h>
+
+/// The number of lanes in a b2FloatW.
+#define b2_simdWidth 4
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define B2_SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define B2_SIMD_SSE2 0
+#endif
+
+#if B2_SIMD_SSE2
+
+/// Four floats operated on together.
+struct b2FloatW
+{
+	__m128 v;
+};
+
+/// The result of a lane-wise comparison.
+struct b2MaskW
+{
+	__m128 v;
+};
+
+inline b2FloatW b2MakeW(__m128 v)
+{
+	b2FloatW r;
+	r.v = v;
+	return r;
+}
+
+inline b2MaskW b2MakeMaskW(__m128 v)
+{
+	b2MaskW r;
+	r.v = v;
+	return r;
+}
+
+/// Load four floats. p need not be aligned.
+inline b2FloatW b2LoadW(const float32* p)
+{
+	return b2MakeW(_mm_loadu_ps(p));
+}
+
+inline void b2StoreW(float32* p, b2FloatW a)
+{
+	_mm_storeu_ps(p, a.v);
+}
+
+inline b2FloatW b2SplatW(float32 a)
+{
+	return b2MakeW(_mm_set1_ps(a));
+}
+
+inline b2FloatW b2ZeroW()
+{
+	return b2MakeW(_mm_setzero_ps());
+}
+
+inline b2FloatW operator + (b2FloatW a, b2FloatW b)
+{
+	return b2MakeW(_mm_add_ps(a.v, b.v));
+}
+
+inline b2FloatW operator - (b2FloatW a, b2FloatW b)
+{
+	return b2MakeW(_mm_sub_ps(a.v, b.v));
+}
+
+inline b2FloatW operator * (b2FloatW a, b2FloatW b)
+{
+	return b2MakeW(_mm_mul_ps(a.v, b.v));
+}
+
+inline b2FloatW operator - (b2FloatW a)
+{
+	return b2MakeW(_mm_sub_ps(_mm_setzero_ps(), a.v));
+}
+
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b)
+{
+	return b2MakeW(_mm_min_ps(a.v, b.v));
+}
+
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b)
+{
+	return b2MakeW(_mm_max_ps(a.v, b.v));
+}
+
+/// Lanes where a >= b.
+inline b2MaskW b2GreaterEqualW(b2FloatW a, b2FloatW b)
+{
+	return b2MakeMaskW(_mm_cmpge_ps(a.v, b.v));
+}
+
+inline b2FloatW b2AbsW(b2FloatW a)
+{
+	return b2MaxW(a, -a);
+}
+
+inline b2MaskW b2AndW(b2MaskW a, b2MaskW b)
+{
+	return b2MakeMaskW(_mm_and_ps(a.v, b.v));
+}
+
+/// One bit per lane, set where mask is set.
+inline int32 b2MoveMaskW(b2MaskW mask)
+{
+	return _mm_movemask_ps(mask.v);
+}
+
+/// Lanes of a where mask is set, b elsewhere.
+inline b2FloatW b2SelectW(b2MaskW mask, b2FloatW a, b2FloatW b)
+{
+	return b2MakeW(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+}
+
+#else
+
+/// Four floats operated on together. This is the portable version, for
+/// targets without SSE2.
+struct b2FloatW
+{
+	float32 v[b2_simdWidth];
+};
+
+/// The result of a lane-wise comparison.
+struct b2MaskW
+{
+	bool v[b2_simdWidth];
+};
+
+inline b2FloatW b2LoadW(const float32* p)
+{
+	b2FloatW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = p[i];
+	}
+	return r;
+}
+
+inline void b2StoreW(float32* p, b2FloatW a)
+{
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		p[i] = a.v[i];
+	}
+}
+
+inline b2FloatW b2SplatW(float32 a)
+{
+	b2FloatW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = a;
+	}
+	return r;
+}
+
+inline b2FloatW b2ZeroW()
+{
+	return b2SplatW(0.0f);
+}
+
+#define B2_SIMD_BINARY_OP(op) \
+inline b2FloatW operator op (b2FloatW a, b2FloatW b) \
+{ \
+	b2FloatW r; \
+	for (int32 i = 0; i < b2_simdWidth; ++i) \
+	{ \
+		r.v[i] = a.v[i] op b.v[i]; \
+	} \
+	return r; \
+}
+
+B2_SIMD_BINARY_OP(+)
+B2_SIMD_BINARY_OP(-)
+B2_SIMD_BINARY_OP(*)
+
+#undef B2_SIMD_BINARY_OP
+
+inline b2FloatW operator - (b2FloatW a)
+{
+	return b2ZeroW() - a;
+}
+
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b)
+{
+	b2FloatW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+	}
+	return r;
+}
+
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b)
+{
+	b2FloatW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+	}
+	return r;
+}
+
+inline b2MaskW b2GreaterEqualW(b2FloatW a, b2FloatW b)
+{
+	b2MaskW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = a.v[i] >= b.v[i];
+	}
+	return r;
+}
+
+inline b2FloatW b2AbsW(b2FloatW a)
+{
+	return b2MaxW(a, -a);
+}
+
+inline b2MaskW b2AndW(b2MaskW a, b2MaskW b)
+{
+	b2MaskW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = a.v[i] && b.v[i];
+	}
+	return r;
+}
+
+inline int32 b2MoveMaskW(b2MaskW mask)
+{
+	int32 bits = 0;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		bits |= mask.v[i] ? 1 << i : 0;
+	}
+	return bits;
+}
+
+inline b2FloatW b2SelectW(b2MaskW mask, b2FloatW a, b2FloatW b)
+{
+	b2FloatW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+	}
+	return r;
+}
+
+#endif
+
+#endif
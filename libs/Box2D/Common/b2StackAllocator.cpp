@@ -18,39 +18,108 @@
 
 #include <Box2D/Common/b2StackAllocator.h>
 #include <Box2D/Common/b2Math.h>
+#include <string.h>
 
 b2StackAllocator::b2StackAllocator()
 {
+	m_segmentCapacity = 4;
+	m_segmentCount = 0;
+	m_segments = (b2StackSegment*)b2Alloc(m_segmentCapacity * sizeof(b2StackSegment));
+	AddSegment(b2_stackSize);
+
+	m_segment = 0;
 	m_index = 0;
 	m_allocation = 0;
 	m_maxAllocation = 0;
+	m_growCount = 0;
+
+	m_entryCapacity = b2_maxStackEntries;
 	m_entryCount = 0;
+	m_entries = (b2StackEntry*)b2Alloc(m_entryCapacity * sizeof(b2StackEntry));
 }
 
 b2StackAllocator::~b2StackAllocator()
 {
-	b2Assert(m_index == 0);
+	b2Assert(m_allocation == 0);
 	b2Assert(m_entryCount == 0);
+
+	for (int32 i = 0; i < m_segmentCount; ++i)
+	{
+		b2Free(m_segments[i].data);
+	}
+	b2Free(m_segments);
+	b2Free(m_entries);
+}
+
+void b2StackAllocator::AddSegment(int32 size)
+{
+	if (m_segmentCount == m_segmentCapacity)
+	{
+		b2StackSegment* oldSegments = m_segments;
+		m_segmentCapacity *= 2;
+		m_segments = (b2StackSegment*)b2Alloc(m_segmentCapacity * sizeof(b2StackSegment));
+		memcpy(m_segments, oldSegments, m_segmentCount * sizeof(b2StackSegment));
+		b2Free(oldSegments);
+	}
+
+	b2StackSegment* segment = m_segments + m_segmentCount;
+	segment->data = (char*)b2Alloc(size);
+	segment->size = size;
+	++m_segmentCount;
+}
+
+// Replace the segments by one as large as all of them together. Only
+// called when the stack is empty.
+void b2StackAllocator::MergeSegments()
+{
+	b2Assert(m_entryCount == 0);
+
+	int32 size = GetCapacity();
+	for (int32 i = 0; i < m_segmentCount; ++i)
+	{
+		b2Free(m_segments[i].data);
+	}
+	m_segmentCount = 0;
+
+	AddSegment(size);
+	++m_growCount;
+	m_segment = 0;
+	m_index = 0;
 }
 
 void* b2StackAllocator::Allocate(int32 size)
 {
-	b2Assert(m_entryCount < b2_maxStackEntries);
+	if (m_entryCount == m_entryCapacity)
+	{
+		b2StackEntry* oldEntries = m_entries;
+		m_entryCapacity *= 2;
+		m_entries = (b2StackEntry*)b2Alloc(m_entryCapacity * sizeof(b2StackEntry));
+		memcpy(m_entries, oldEntries, m_entryCount * sizeof(b2StackEntry));
+		b2Free(oldEntries);
+		++m_growCount;
+	}
 
 	b2StackEntry* entry = m_entries + m_entryCount;
 	entry->size = size;
-	if (m_index + size > b2_stackSize)
-	{
-		entry->data = (char*)b2Alloc(size);
-		entry->usedMalloc = true;
-	}
-	else
+	entry->segment = m_segment;
+	entry->index = m_index;
+
+	// Move on to the next segment that has room, adding one if needed.
+	while (m_index + size > m_segments[m_segment].size)
 	{
-		entry->data = m_data + m_index;
-		entry->usedMalloc = false;
-		m_index += size;
+		if (m_segment + 1 == m_segmentCount)
+		{
+			AddSegment(b2Max(size, 2 * m_segments[m_segment].size));
+			++m_growCount;
+		}
+
+		++m_segment;
+		m_index = 0;
 	}
 
+	entry->data = m_segments[m_segment].data + m_index;
+	m_index += size;
+
 	m_allocation += size;
 	m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
 	++m_entryCount;
@@ -63,17 +132,16 @@ void b2StackAllocator::Free(void* p)
 	b2Assert(m_entryCount > 0);
 	b2StackEntry* entry = m_entries + m_entryCount - 1;
 	b2Assert(p == entry->data);
-	if (entry->usedMalloc)
-	{
-		b2Free(p);
-	}
-	else
-	{
-		m_index -= entry->size;
-	}
+	m_segment = entry->segment;
+	m_index = entry->index;
 	m_allocation -= entry->size;
 	--m_entryCount;
 
+	if (m_entryCount == 0 && m_segmentCount > 1)
+	{
+		MergeSegments();
+	}
+
 	p = NULL;
 }
 
@@ -81,3 +149,24 @@ int32 b2StackAllocator::GetMaxAllocation() const
 {
 	return m_maxAllocation;
 }
+
+int32 b2StackAllocator::GetGrowCount() const
+{
+	return m_growCount;
+}
+
+int32 b2StackAllocator::GetCapacity() const
+{
+	int32 capacity = 0;
+	for (int32 i = 0; i < m_segmentCount; ++i)
+	{
+		capacity += m_segments[i].size;
+	}
+	return capacity;
+}
+
+void b2StackAllocator::ResetStats()
+{
+	m_maxAllocation = m_allocation;
+	m_growCount = 0;
+}
@@ -21,19 +21,34 @@
 
 #include <Box2D/Common/b2Settings.h>
 
-const int32 b2_stackSize = 100 * 1024;	// 100k
-const int32 b2_maxStackEntries = 32;
+const int32 b2_stackSize = 100 * 1024;	// 100k, the size of the first segment
+const int32 b2_maxStackEntries = 32;	// initial entry capacity
 
 struct b2StackEntry
 {
 	char* data;
 	int32 size;
-	bool usedMalloc;
+
+	// Where the top of the stack was before this allocation.
+	int32 segment;
+	int32 index;
+};
+
+struct b2StackSegment
+{
+	char* data;
+	int32 size;
 };
 
 // This is a stack allocator used for fast per step allocations.
 // You must nest allocate/free pairs. The code will assert
 // if you try to interleave multiple allocate/free pairs.
+//
+// When an allocation does not fit, the stack continues in a new segment
+// twice the size of the last, taken from the heap. Segments never move, so
+// earlier allocations stay valid. Once the stack is empty again the
+// segments are merged into one that holds them all, so after a few steps
+// the stack stops touching the heap.
 class b2StackAllocator
 {
 public:
@@ -43,18 +58,39 @@ public:
 	void* Allocate(int32 size);
 	void Free(void* p);
 
+	/// Get the largest total allocation since construction or ResetStats.
 	int32 GetMaxAllocation() const;
 
+	/// Get the number of heap allocations made to grow the stack since
+	/// construction or ResetStats.
+	int32 GetGrowCount() const;
+
+	/// Get the bytes reserved in all segments.
+	int32 GetCapacity() const;
+
+	/// Start measuring the maximum allocation and the grow count again.
+	void ResetStats();
+
 private:
 
-	char m_data[b2_stackSize];
+	void AddSegment(int32 size);
+	void MergeSegments();
+
+	b2StackSegment* m_segments;
+	int32 m_segmentCount;
+	int32 m_segmentCapacity;
+
+	// The top of the stack is at m_index in m_segments[m_segment].
+	int32 m_segment;
 	int32 m_index;
 
 	int32 m_allocation;
 	int32 m_maxAllocation;
+	int32 m_growCount;
 
-	b2StackEntry m_entries[b2_maxStackEntries];
+	b2StackEntry* m_entries;
 	int32 m_entryCount;
+	int32 m_entryCapacity;
 };
 
 #endif
@@ -0,0 +1,147 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Common/b2ThreadPool.h>
+#include <Box2D/Common/b2Math.h>
+
+b2ThreadPool::b2ThreadPool(int32 threadCount)
+{
+	if (threadCount <= 0)
+	{
+		threadCount = (int32)std::thread::hardware_concurrency();
+	}
+
+	m_threadCount = b2Max(threadCount, 1);
+	m_task = NULL;
+	m_count = 0;
+	m_next = 0;
+	m_generation = 0;
+	m_busyWorkers = 0;
+	m_stopping = false;
+
+	// Thread 0 is the caller of ParallelFor.
+	m_threads = new std::thread[m_threadCount - 1];
+	for (int32 i = 1; i < m_threadCount; ++i)
+	{
+		m_threads[i - 1] = std::thread(&b2ThreadPool::WorkerMain, this, i);
+	}
+}
+
+b2ThreadPool::~b2ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_workReady.notify_all();
+
+	for (int32 i = 0; i < m_threadCount - 1; ++i)
+	{
+		m_threads[i].join();
+	}
+	delete [] m_threads;
+}
+
+int32 b2ThreadPool::GetThreadCount() const
+{
+	return m_threadCount;
+}
+
+void b2ThreadPool::RunItems(int32 threadIndex)
+{
+	for (;;)
+	{
+		int32 index = m_next.fetch_add(1);
+		if (index >= m_count)
+		{
+			break;
+		}
+
+		m_task->Execute(index, threadIndex);
+	}
+}
+
+void b2ThreadPool::ParallelFor(b2Task* task, int32 count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// Not worth waking anyone for a single item.
+	if (count == 1 || m_threadCount == 1)
+	{
+		for (int32 i = 0; i < count; ++i)
+		{
+			task->Execute(i, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = task;
+		m_count = count;
+		m_next = 0;
+		m_busyWorkers = m_threadCount - 1;
+		++m_generation;
+	}
+	m_workReady.notify_all();
+
+	RunItems(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_busyWorkers > 0)
+	{
+		m_workDone.wait(lock);
+	}
+	m_task = NULL;
+}
+
+void b2ThreadPool::WorkerMain(int32 threadIndex)
+{
+	uint32 generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (m_stopping == false && m_generation == generation)
+			{
+				m_workReady.wait(lock);
+			}
+
+			if (m_stopping)
+			{
+				return;
+			}
+
+			generation = m_generation;
+		}
+
+		RunItems(threadIndex);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			last = --m_busyWorkers == 0;
+		}
+
+		if (last)
+		{
+			m_workDone.notify_one();
+		}
+	}
+}
@@ -0,0 +1,92 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_THREAD_POOL_H
+#define B2_THREAD_POOL_H
+
+#include <Box2D/Common/b2Settings.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// A batch of independent work items run by a b2TaskExecutor.
+class b2Task
+{
+public:
+	virtual ~b2Task() {}
+
+	/// Run work item index. threadIndex is in [0, GetThreadCount()) of the
+	/// executor and is never shared by two items running at the same time,
+	/// so it can be used to pick per-thread scratch memory.
+	virtual void Execute(int32 index, int32 threadIndex) = 0;
+};
+
+/// Runs tasks for the world, possibly on several threads. Implement this to
+/// run Box2D work on your own job system, or use b2ThreadPool.
+class b2TaskExecutor
+{
+public:
+	virtual ~b2TaskExecutor() {}
+
+	/// The number of threads that may execute work items at once, including
+	/// the calling thread.
+	virtual int32 GetThreadCount() const = 0;
+
+	/// Run task->Execute(i, thread) for every i in [0, count) and return once
+	/// all of them have finished. Called from one thread at a time.
+	virtual void ParallelFor(b2Task* task, int32 count) = 0;
+};
+
+/// A simple fixed size thread pool. The calling thread takes part in
+/// ParallelFor as thread 0.
+class b2ThreadPool : public b2TaskExecutor
+{
+public:
+	/// @param threadCount the total thread count including the caller, or 0
+	/// to use one thread per hardware thread.
+	b2ThreadPool(int32 threadCount = 0);
+	~b2ThreadPool();
+
+	int32 GetThreadCount() const;
+
+	void ParallelFor(b2Task* task, int32 count);
+
+private:
+
+	void WorkerMain(int32 threadIndex);
+	void RunItems(int32 threadIndex);
+
+	std::thread* m_threads;
+	int32 m_threadCount;
+
+	std::mutex m_mutex;
+	std::condition_variable m_workReady;
+	std::condition_variable m_workDone;
+
+	b2Task* m_task;
+	int32 m_count;
+	std::atomic<int32> m_next;
+
+	// Bumped for every ParallelFor so sleeping workers can tell new work
+	// from a spurious wake up.
+	uint32 m_generation;
+	int32 m_busyWorkers;
+	bool m_stopping;
+};
+
+#endif
@@ -150,6 +150,7 @@ protected:
 	friend class b2ContactSolver;
 	friend class b2Body;
 	friend class b2Fixture;
+	friend class b2ContactUpdateTask;
 
 	// Flags stored in m_flags
 	enum
@@ -189,6 +190,15 @@ protected:
 
 	void Update(b2ContactListener* listener);
 
+	/// The part of Update that only touches this contact, so it can run on
+	/// any thread. Stores the previous manifold in oldManifold and returns
+	/// whether the contact was touching before.
+	bool UpdateManifold(b2Manifold* oldManifold);
+
+	/// The rest of Update: wake the bodies if touching changed and call the
+	/// listener. Must run on the thread that steps the world.
+	void ReportUpdate(b2ContactListener* listener, const b2Manifold* oldManifold, bool wasTouching);
+
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
 
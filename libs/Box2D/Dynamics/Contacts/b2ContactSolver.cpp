@@ -21,9 +21,13 @@
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2Fixture.h>
+#include <Box2D/Dynamics/b2Island.h>
 #include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Common/b2SIMD.h>
 #include <Box2D/Common/b2StackAllocator.h>
 
+#include <string.h>
+
 #define B2_DEBUG_SOLVER 0
 
 bool g_blockSolve = true;
@@ -43,6 +47,53 @@ struct b2ContactPositionConstraint
 	int32 pointCount;
 };
 
+// The number of colors the wide solver sorts constraints into. Constraints
+// that fit none of them are solved by the scalar solver.
+const int32 b2_wideColorCount = 32;
+
+struct b2WideConstraintPoint
+{
+	float32 rAx[b2_simdWidth], rAy[b2_simdWidth];
+	float32 rBx[b2_simdWidth], rBy[b2_simdWidth];
+	float32 normalImpulse[b2_simdWidth];
+	float32 tangentImpulse[b2_simdWidth];
+	float32 normalMass[b2_simdWidth];
+	float32 tangentMass[b2_simdWidth];
+	float32 velocityBias[b2_simdWidth];
+};
+
+// Up to b2_simdWidth velocity constraints that share no dynamic body, one per
+// lane. Unused lanes have zero mass, so they never change a velocity.
+struct b2WideContactConstraint
+{
+	b2WideConstraintPoint points[b2_maxManifoldPoints];
+	float32 normalX[b2_simdWidth], normalY[b2_simdWidth];
+	float32 invMassA[b2_simdWidth], invMassB[b2_simdWidth];
+	float32 invIA[b2_simdWidth], invIB[b2_simdWidth];
+	float32 friction[b2_simdWidth];
+	float32 tangentSpeed[b2_simdWidth];
+
+	// K and normalMass of the block solver, by row and column.
+	float32 k11[b2_simdWidth], k12[b2_simdWidth], k22[b2_simdWidth];
+	float32 normalMass11[b2_simdWidth], normalMass12[b2_simdWidth];
+	float32 normalMass21[b2_simdWidth], normalMass22[b2_simdWidth];
+
+	int32 indexA[b2_simdWidth];
+	int32 indexB[b2_simdWidth];
+
+	// Whether to write the body velocities back. Static and kinematic bodies
+	// may be in several lanes at once and the solver never changes them.
+	bool writeA[b2_simdWidth];
+	bool writeB[b2_simdWidth];
+
+	// Index of the velocity constraint in each lane, or -1 if unused.
+	int32 constraintIndex[b2_simdWidth];
+
+	// Two point constraints using the block solver. Otherwise the points are
+	// solved one at a time and one point constraints have an unused point.
+	bool block;
+};
+
 b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 {
 	m_step = def->step;
@@ -53,6 +104,11 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 	m_positions = def->positions;
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
+	m_bodyCount = def->island->m_bodyCount;
+	m_wideConstraints = NULL;
+	m_wideCount = 0;
+	m_scalarIndices = NULL;
+	m_scalarCount = 0;
 
 	// Initialize position independent portions of the constraints.
 	for (int32 i = 0; i < m_count; ++i)
@@ -76,8 +132,8 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 		vc->friction = contact->m_friction;
 		vc->restitution = contact->m_restitution;
 		vc->tangentSpeed = contact->m_tangentSpeed;
-		vc->indexA = bodyA->m_islandIndex;
-		vc->indexB = bodyB->m_islandIndex;
+		vc->indexA = def->island->GetIndex(bodyA);
+		vc->indexB = def->island->GetIndex(bodyB);
 		vc->invMassA = bodyA->m_invMass;
 		vc->invMassB = bodyB->m_invMass;
 		vc->invIA = bodyA->m_invI;
@@ -88,8 +144,8 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 		vc->normalMass.SetZero();
 
 		b2ContactPositionConstraint* pc = m_positionConstraints + i;
-		pc->indexA = bodyA->m_islandIndex;
-		pc->indexB = bodyB->m_islandIndex;
+		pc->indexA = vc->indexA;
+		pc->indexB = vc->indexB;
 		pc->invMassA = bodyA->m_invMass;
 		pc->invMassB = bodyB->m_invMass;
 		pc->localCenterA = bodyA->m_sweep.localCenter;
@@ -132,6 +188,12 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_wideConstraints != NULL)
+	{
+		m_allocator->Free(m_scalarIndices);
+		m_allocator->Free(m_wideConstraints);
+	}
+
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
@@ -246,6 +308,155 @@ void b2ContactSolver::InitializeVelocityConstraints()
 			}
 		}
 	}
+
+	if (m_step.wideSolver)
+	{
+		InitializeWideConstraints();
+	}
+}
+
+void b2ContactSolver::InitializeWideConstraints()
+{
+	// Each color holds two kinds of batches, block and one point at a time.
+	// At most one batch of each is partly filled.
+	int32 capacity = (m_count + b2_simdWidth - 1) / b2_simdWidth + 2 * b2_wideColorCount;
+	m_wideConstraints = (b2WideContactConstraint*)m_allocator->Allocate(capacity * sizeof(b2WideContactConstraint));
+	m_scalarIndices = (int32*)m_allocator->Allocate(m_count * sizeof(int32));
+	m_wideCount = 0;
+	m_scalarCount = 0;
+
+	uint32* bodyColors = (uint32*)m_allocator->Allocate(m_bodyCount * sizeof(uint32));
+	int32* groups = (int32*)m_allocator->Allocate(m_count * sizeof(int32));
+	memset(bodyColors, 0, m_bodyCount * sizeof(uint32));
+
+	// Give each constraint the first color none of its dynamic bodies has
+	// used yet, so no two constraints of a color touch the same dynamic body.
+	int32 groupCounts[2 * b2_wideColorCount];
+	memset(groupCounts, 0, sizeof(groupCounts));
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		bool dynamicA = vc->invMassA > 0.0f || vc->invIA > 0.0f;
+		bool dynamicB = vc->invMassB > 0.0f || vc->invIB > 0.0f;
+
+		uint32 used = 0;
+		if (dynamicA)
+		{
+			used |= bodyColors[vc->indexA];
+		}
+		if (dynamicB)
+		{
+			used |= bodyColors[vc->indexB];
+		}
+
+		if (used == 0xFFFFFFFF)
+		{
+			groups[i] = -1;
+			m_scalarIndices[m_scalarCount++] = i;
+			continue;
+		}
+
+		int32 color = 0;
+		while (used & (1u << color))
+		{
+			++color;
+		}
+
+		if (dynamicA)
+		{
+			bodyColors[vc->indexA] |= 1u << color;
+		}
+		if (dynamicB)
+		{
+			bodyColors[vc->indexB] |= 1u << color;
+		}
+
+		bool block = vc->pointCount == 2 && g_blockSolve;
+		groups[i] = 2 * color + (block ? 1 : 0);
+		++groupCounts[groups[i]];
+	}
+
+	// Lay the batches out color by color.
+	int32 groupStarts[2 * b2_wideColorCount];
+	for (int32 i = 0; i < 2 * b2_wideColorCount; ++i)
+	{
+		groupStarts[i] = m_wideCount;
+		m_wideCount += (groupCounts[i] + b2_simdWidth - 1) / b2_simdWidth;
+	}
+	b2Assert(m_wideCount <= capacity);
+
+	memset(m_wideConstraints, 0, m_wideCount * sizeof(b2WideContactConstraint));
+	for (int32 i = 0; i < 2 * b2_wideColorCount; ++i)
+	{
+		for (int32 j = groupStarts[i]; j < groupStarts[i] + (groupCounts[i] + b2_simdWidth - 1) / b2_simdWidth; ++j)
+		{
+			b2WideContactConstraint* wc = m_wideConstraints + j;
+			wc->block = (i & 1) == 1;
+			for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+			{
+				wc->constraintIndex[lane] = -1;
+			}
+		}
+	}
+
+	int32 groupFill[2 * b2_wideColorCount];
+	memset(groupFill, 0, sizeof(groupFill));
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		int32 group = groups[i];
+		if (group < 0)
+		{
+			continue;
+		}
+
+		int32 slot = groupFill[group]++;
+		b2WideContactConstraint* wc = m_wideConstraints + groupStarts[group] + slot / b2_simdWidth;
+		int32 lane = slot % b2_simdWidth;
+
+		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		wc->constraintIndex[lane] = i;
+		wc->indexA[lane] = vc->indexA;
+		wc->indexB[lane] = vc->indexB;
+		wc->writeA[lane] = vc->invMassA > 0.0f || vc->invIA > 0.0f;
+		wc->writeB[lane] = vc->invMassB > 0.0f || vc->invIB > 0.0f;
+		wc->normalX[lane] = vc->normal.x;
+		wc->normalY[lane] = vc->normal.y;
+		wc->invMassA[lane] = vc->invMassA;
+		wc->invMassB[lane] = vc->invMassB;
+		wc->invIA[lane] = vc->invIA;
+		wc->invIB[lane] = vc->invIB;
+		wc->friction[lane] = vc->friction;
+		wc->tangentSpeed[lane] = vc->tangentSpeed;
+
+		for (int32 j = 0; j < vc->pointCount; ++j)
+		{
+			const b2VelocityConstraintPoint* vcp = vc->points + j;
+			b2WideConstraintPoint* wcp = wc->points + j;
+			wcp->rAx[lane] = vcp->rA.x;
+			wcp->rAy[lane] = vcp->rA.y;
+			wcp->rBx[lane] = vcp->rB.x;
+			wcp->rBy[lane] = vcp->rB.y;
+			wcp->normalImpulse[lane] = vcp->normalImpulse;
+			wcp->tangentImpulse[lane] = vcp->tangentImpulse;
+			wcp->normalMass[lane] = vcp->normalMass;
+			wcp->tangentMass[lane] = vcp->tangentMass;
+			wcp->velocityBias[lane] = vcp->velocityBias;
+		}
+
+		if (wc->block)
+		{
+			wc->k11[lane] = vc->K.ex.x;
+			wc->k12[lane] = vc->K.ex.y;
+			wc->k22[lane] = vc->K.ey.y;
+			wc->normalMass11[lane] = vc->normalMass.ex.x;
+			wc->normalMass12[lane] = vc->normalMass.ey.x;
+			wc->normalMass21[lane] = vc->normalMass.ex.y;
+			wc->normalMass22[lane] = vc->normalMass.ey.y;
+		}
+	}
+
+	m_allocator->Free(groups);
+	m_allocator->Free(bodyColors);
 }
 
 void b2ContactSolver::WarmStart()
@@ -290,319 +501,579 @@ void b2ContactSolver::WarmStart()
 
 void b2ContactSolver::SolveVelocityConstraints()
 {
+	if (m_wideConstraints != NULL)
+	{
+		SolveWideVelocityConstraints();
+		return;
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
-		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		SolveVelocityConstraint(m_velocityConstraints + i);
+	}
+}
 
-		int32 indexA = vc->indexA;
-		int32 indexB = vc->indexB;
-		float32 mA = vc->invMassA;
-		float32 iA = vc->invIA;
-		float32 mB = vc->invMassB;
-		float32 iB = vc->invIB;
-		int32 pointCount = vc->pointCount;
+void b2ContactSolver::SolveVelocityConstraint(b2ContactVelocityConstraint* vc)
+{
+	int32 indexA = vc->indexA;
+	int32 indexB = vc->indexB;
+	float32 mA = vc->invMassA;
+	float32 iA = vc->invIA;
+	float32 mB = vc->invMassB;
+	float32 iB = vc->invIB;
+	int32 pointCount = vc->pointCount;
+
+	b2Vec2 vA = m_velocities[indexA].v;
+	float32 wA = m_velocities[indexA].w;
+	b2Vec2 vB = m_velocities[indexB].v;
+	float32 wB = m_velocities[indexB].w;
+
+	b2Vec2 normal = vc->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+	float32 friction = vc->friction;
+
+	b2Assert(pointCount == 1 || pointCount == 2);
+
+	// Solve tangent constraints first because non-penetration is more important
+	// than friction.
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		b2VelocityConstraintPoint* vcp = vc->points + j;
 
-		b2Vec2 vA = m_velocities[indexA].v;
-		float32 wA = m_velocities[indexA].w;
-		b2Vec2 vB = m_velocities[indexB].v;
-		float32 wB = m_velocities[indexB].w;
+		// Relative velocity at contact
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
 
-		b2Vec2 normal = vc->normal;
-		b2Vec2 tangent = b2Cross(normal, 1.0f);
-		float32 friction = vc->friction;
+		// Compute tangent force
+		float32 vt = b2Dot(dv, tangent) - vc->tangentSpeed;
+		float32 lambda = vcp->tangentMass * (-vt);
 
-		b2Assert(pointCount == 1 || pointCount == 2);
+		// b2Clamp the accumulated force
+		float32 maxFriction = friction * vcp->normalImpulse;
+		float32 newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - vcp->tangentImpulse;
+		vcp->tangentImpulse = newImpulse;
 
-		// Solve tangent constraints first because non-penetration is more important
-		// than friction.
-		for (int32 j = 0; j < pointCount; ++j)
+		// Apply contact impulse
+		b2Vec2 P = lambda * tangent;
+
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
+
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
+
+	// Solve normal constraints
+	if (pointCount == 1 || g_blockSolve == false)
+	{
+		for (int32 i = 0; i < pointCount; ++i)
 		{
-			b2VelocityConstraintPoint* vcp = vc->points + j;
+			b2VelocityConstraintPoint* vcp = vc->points + i;
 
 			// Relative velocity at contact
 			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
 
-			// Compute tangent force
-			float32 vt = b2Dot(dv, tangent) - vc->tangentSpeed;
-			float32 lambda = vcp->tangentMass * (-vt);
+			// Compute normal impulse
+			float32 vn = b2Dot(dv, normal);
+			float32 lambda = -vcp->normalMass * (vn - vcp->velocityBias);
 
-			// b2Clamp the accumulated force
-			float32 maxFriction = friction * vcp->normalImpulse;
-			float32 newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
-			lambda = newImpulse - vcp->tangentImpulse;
-			vcp->tangentImpulse = newImpulse;
+			// b2Clamp the accumulated impulse
+			float32 newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
+			lambda = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
 
 			// Apply contact impulse
-			b2Vec2 P = lambda * tangent;
-
+			b2Vec2 P = lambda * normal;
 			vA -= mA * P;
 			wA -= iA * b2Cross(vcp->rA, P);
 
 			vB += mB * P;
 			wB += iB * b2Cross(vcp->rB, P);
 		}
-
-		// Solve normal constraints
-		if (pointCount == 1 || g_blockSolve == false)
+	}
+	else
+	{
+		// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
+		// Build the mini LCP for this contact patch
+		//
+		// vn = A * x + b, vn >= 0, , vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
+		//
+		// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
+		// b = vn0 - velocityBias
+		//
+		// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
+		// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
+		// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
+		// solution that satisfies the problem is chosen.
+		// 
+		// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
+		// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
+		//
+		// Substitute:
+		// 
+		// x = a + d
+		// 
+		// a := old total impulse
+		// x := new total impulse
+		// d := incremental impulse 
+		//
+		// For the current iteration we extend the formula for the incremental impulse
+		// to compute the new total impulse:
+		//
+		// vn = A * d + b
+		//    = A * (x - a) + b
+		//    = A * x + b - A * a
+		//    = A * x + b'
+		// b' = b - A * a;
+
+		b2VelocityConstraintPoint* cp1 = vc->points + 0;
+		b2VelocityConstraintPoint* cp2 = vc->points + 1;
+
+		b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
+		b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+
+		// Relative velocity at contact
+		b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+		b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+
+		// Compute normal velocity
+		float32 vn1 = b2Dot(dv1, normal);
+		float32 vn2 = b2Dot(dv2, normal);
+
+		b2Vec2 b;
+		b.x = vn1 - cp1->velocityBias;
+		b.y = vn2 - cp2->velocityBias;
+
+		// Compute b'
+		b -= b2Mul(vc->K, a);
+
+		const float32 k_errorTol = 1e-3f;
+		B2_NOT_USED(k_errorTol);
+
+		for (;;)
 		{
-			for (int32 i = 0; i < pointCount; ++i)
+			//
+			// Case 1: vn = 0
+			//
+			// 0 = A * x + b'
+			//
+			// Solve for x:
+			//
+			// x = - inv(A) * b'
+			//
+			b2Vec2 x = - b2Mul(vc->normalMass, b);
+
+			if (x.x >= 0.0f && x.y >= 0.0f)
 			{
-				b2VelocityConstraintPoint* vcp = vc->points + i;
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
 
-				// Relative velocity at contact
-				b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-				// Compute normal impulse
-				float32 vn = b2Dot(dv, normal);
-				float32 lambda = -vcp->normalMass * (vn - vcp->velocityBias);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-				// b2Clamp the accumulated impulse
-				float32 newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
-				lambda = newImpulse - vcp->normalImpulse;
-				vcp->normalImpulse = newImpulse;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-				// Apply contact impulse
-				b2Vec2 P = lambda * normal;
-				vA -= mA * P;
-				wA -= iA * b2Cross(vcp->rA, P);
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+				dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
 
-				vB += mB * P;
-				wB += iB * b2Cross(vcp->rB, P);
+				// Compute normal velocity
+				vn1 = b2Dot(dv1, normal);
+				vn2 = b2Dot(dv2, normal);
+
+				b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+				b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
+#endif
+				break;
 			}
-		}
-		else
-		{
-			// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
-			// Build the mini LCP for this contact patch
-			//
-			// vn = A * x + b, vn >= 0, , vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
+
 			//
-			// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
-			// b = vn0 - velocityBias
+			// Case 2: vn1 = 0 and x2 = 0
 			//
-			// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
-			// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
-			// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
-			// solution that satisfies the problem is chosen.
-			// 
-			// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
-			// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
+			//   0 = a11 * x1 + a12 * 0 + b1' 
+			// vn2 = a21 * x1 + a22 * 0 + b2'
 			//
-			// Substitute:
-			// 
-			// x = a + d
-			// 
-			// a := old total impulse
-			// x := new total impulse
-			// d := incremental impulse 
-			//
-			// For the current iteration we extend the formula for the incremental impulse
-			// to compute the new total impulse:
-			//
-			// vn = A * d + b
-			//    = A * (x - a) + b
-			//    = A * x + b - A * a
-			//    = A * x + b'
-			// b' = b - A * a;
+			x.x = - cp1->normalMass * b.x;
+			x.y = 0.0f;
+			vn1 = 0.0f;
+			vn2 = vc->K.ex.y * x.x + b.y;
 
-			b2VelocityConstraintPoint* cp1 = vc->points + 0;
-			b2VelocityConstraintPoint* cp2 = vc->points + 1;
+			if (x.x >= 0.0f && vn2 >= 0.0f)
+			{
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
 
-			b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
-			b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-			// Relative velocity at contact
-			b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
-			b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-			// Compute normal velocity
-			float32 vn1 = b2Dot(dv1, normal);
-			float32 vn2 = b2Dot(dv2, normal);
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-			b2Vec2 b;
-			b.x = vn1 - cp1->velocityBias;
-			b.y = vn2 - cp2->velocityBias;
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
 
-			// Compute b'
-			b -= b2Mul(vc->K, a);
+				// Compute normal velocity
+				vn1 = b2Dot(dv1, normal);
 
-			const float32 k_errorTol = 1e-3f;
-			B2_NOT_USED(k_errorTol);
+				b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+#endif
+				break;
+			}
+
+
+			//
+			// Case 3: vn2 = 0 and x1 = 0
+			//
+			// vn1 = a11 * 0 + a12 * x2 + b1' 
+			//   0 = a21 * 0 + a22 * x2 + b2'
+			//
+			x.x = 0.0f;
+			x.y = - cp2->normalMass * b.y;
+			vn1 = vc->K.ey.x * x.y + b.x;
+			vn2 = 0.0f;
 
-			for (;;)
+			if (x.y >= 0.0f && vn1 >= 0.0f)
 			{
-				//
-				// Case 1: vn = 0
-				//
-				// 0 = A * x + b'
-				//
-				// Solve for x:
-				//
-				// x = - inv(A) * b'
-				//
-				b2Vec2 x = - b2Mul(vc->normalMass, b);
-
-				if (x.x >= 0.0f && x.y >= 0.0f)
-				{
-					// Get the incremental impulse
-					b2Vec2 d = x - a;
-
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
-
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
-
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
-					dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-					// Compute normal velocity
-					vn1 = b2Dot(dv1, normal);
-					vn2 = b2Dot(dv2, normal);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-					b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
-					b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
-#endif
-					break;
-				}
-
-				//
-				// Case 2: vn1 = 0 and x2 = 0
-				//
-				//   0 = a11 * x1 + a12 * 0 + b1' 
-				// vn2 = a21 * x1 + a22 * 0 + b2'
-				//
-				x.x = - cp1->normalMass * b.x;
-				x.y = 0.0f;
-				vn1 = 0.0f;
-				vn2 = vc->K.ex.y * x.x + b.y;
-
-				if (x.x >= 0.0f && vn2 >= 0.0f)
-				{
-					// Get the incremental impulse
-					b2Vec2 d = x - a;
-
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
-
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
-
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
 #if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+				// Postconditions
+				dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
 
-					// Compute normal velocity
-					vn1 = b2Dot(dv1, normal);
+				// Compute normal velocity
+				vn2 = b2Dot(dv2, normal);
 
-					b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+				b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
 #endif
-					break;
-				}
-
-
-				//
-				// Case 3: vn2 = 0 and x1 = 0
-				//
-				// vn1 = a11 * 0 + a12 * x2 + b1' 
-				//   0 = a21 * 0 + a22 * x2 + b2'
-				//
-				x.x = 0.0f;
-				x.y = - cp2->normalMass * b.y;
-				vn1 = vc->K.ey.x * x.y + b.x;
-				vn2 = 0.0f;
-
-				if (x.y >= 0.0f && vn1 >= 0.0f)
-				{
-					// Resubstitute for the incremental impulse
-					b2Vec2 d = x - a;
-
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
-
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
-
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				break;
+			}
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+			//
+			// Case 4: x1 = 0 and x2 = 0
+			// 
+			// vn1 = b1
+			// vn2 = b2;
+			x.x = 0.0f;
+			x.y = 0.0f;
+			vn1 = b.x;
+			vn2 = b.y;
+
+			if (vn1 >= 0.0f && vn2 >= 0.0f )
+			{
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
 
-					// Compute normal velocity
-					vn2 = b2Dot(dv2, normal);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-					b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
-#endif
-					break;
-				}
-
-				//
-				// Case 4: x1 = 0 and x2 = 0
-				// 
-				// vn1 = b1
-				// vn2 = b2;
-				x.x = 0.0f;
-				x.y = 0.0f;
-				vn1 = b.x;
-				vn2 = b.y;
-
-				if (vn1 >= 0.0f && vn2 >= 0.0f )
-				{
-					// Resubstitute for the incremental impulse
-					b2Vec2 d = x - a;
-
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
-
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
-
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
-
-					break;
-				}
-
-				// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
 				break;
 			}
+
+			// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
+			break;
 		}
+	}
 
-		m_velocities[indexA].v = vA;
-		m_velocities[indexA].w = wA;
-		m_velocities[indexB].v = vB;
-		m_velocities[indexB].w = wB;
+	m_velocities[indexA].v = vA;
+	m_velocities[indexA].w = wA;
+	m_velocities[indexB].v = vB;
+	m_velocities[indexB].w = wB;
+}
+
+static void b2GatherVelocities(b2FloatW* vx, b2FloatW* vy, b2FloatW* w, const b2Velocity* velocities, const int32* indices)
+{
+	float32 x[b2_simdWidth], y[b2_simdWidth], a[b2_simdWidth];
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		const b2Velocity& v = velocities[indices[lane]];
+		x[lane] = v.v.x;
+		y[lane] = v.v.y;
+		a[lane] = v.w;
+	}
+
+	*vx = b2LoadW(x);
+	*vy = b2LoadW(y);
+	*w = b2LoadW(a);
+}
+
+static void b2ScatterVelocities(b2Velocity* velocities, const int32* indices, const bool* write, b2FloatW vx, b2FloatW vy, b2FloatW w)
+{
+	float32 x[b2_simdWidth], y[b2_simdWidth], a[b2_simdWidth];
+	b2StoreW(x, vx);
+	b2StoreW(y, vy);
+	b2StoreW(a, w);
+
+	for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+	{
+		if (write[lane])
+		{
+			b2Velocity& v = velocities[indices[lane]];
+			v.v.Set(x[lane], y[lane]);
+			v.w = a[lane];
+		}
+	}
+}
+
+// The same steps as SolveVelocityConstraint, one lane per constraint. The
+// block solver tries all four cases and picks the first that holds.
+void b2ContactSolver::SolveWideVelocityConstraints()
+{
+	b2FloatW zero = b2ZeroW();
+
+	for (int32 i = 0; i < m_wideCount; ++i)
+	{
+		b2WideContactConstraint* wc = m_wideConstraints + i;
+
+		b2FloatW vAx, vAy, wA, vBx, vBy, wB;
+		b2GatherVelocities(&vAx, &vAy, &wA, m_velocities, wc->indexA);
+		b2GatherVelocities(&vBx, &vBy, &wB, m_velocities, wc->indexB);
+
+		b2FloatW mA = b2LoadW(wc->invMassA);
+		b2FloatW iA = b2LoadW(wc->invIA);
+		b2FloatW mB = b2LoadW(wc->invMassB);
+		b2FloatW iB = b2LoadW(wc->invIB);
+
+		b2FloatW normalX = b2LoadW(wc->normalX);
+		b2FloatW normalY = b2LoadW(wc->normalY);
+		b2FloatW tangentX = normalY;
+		b2FloatW tangentY = -normalX;
+		b2FloatW friction = b2LoadW(wc->friction);
+		b2FloatW tangentSpeed = b2LoadW(wc->tangentSpeed);
+
+		// Solve tangent constraints first because non-penetration is more important
+		// than friction.
+		for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+		{
+			b2WideConstraintPoint* cp = wc->points + j;
+			b2FloatW rAx = b2LoadW(cp->rAx);
+			b2FloatW rAy = b2LoadW(cp->rAy);
+			b2FloatW rBx = b2LoadW(cp->rBx);
+			b2FloatW rBy = b2LoadW(cp->rBy);
+
+			// Relative velocity at contact
+			b2FloatW dvx = vBx - wB * rBy - vAx + wA * rAy;
+			b2FloatW dvy = vBy + wB * rBx - vAy - wA * rAx;
+
+			// Compute tangent force
+			b2FloatW vt = dvx * tangentX + dvy * tangentY - tangentSpeed;
+			b2FloatW lambda = -(b2LoadW(cp->tangentMass) * vt);
+
+			// Clamp the accumulated force
+			b2FloatW oldImpulse = b2LoadW(cp->tangentImpulse);
+			b2FloatW maxFriction = friction * b2LoadW(cp->normalImpulse);
+			b2FloatW newImpulse = b2MaxW(-maxFriction, b2MinW(oldImpulse + lambda, maxFriction));
+			lambda = newImpulse - oldImpulse;
+			b2StoreW(cp->tangentImpulse, newImpulse);
+
+			// Apply contact impulse
+			b2FloatW Px = lambda * tangentX;
+			b2FloatW Py = lambda * tangentY;
+
+			vAx = vAx - mA * Px;
+			vAy = vAy - mA * Py;
+			wA = wA - iA * (rAx * Py - rAy * Px);
+
+			vBx = vBx + mB * Px;
+			vBy = vBy + mB * Py;
+			wB = wB + iB * (rBx * Py - rBy * Px);
+		}
+
+		// Solve normal constraints
+		if (wc->block == false)
+		{
+			for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+			{
+				b2WideConstraintPoint* cp = wc->points + j;
+				b2FloatW rAx = b2LoadW(cp->rAx);
+				b2FloatW rAy = b2LoadW(cp->rAy);
+				b2FloatW rBx = b2LoadW(cp->rBx);
+				b2FloatW rBy = b2LoadW(cp->rBy);
+
+				// Relative velocity at contact
+				b2FloatW dvx = vBx - wB * rBy - vAx + wA * rAy;
+				b2FloatW dvy = vBy + wB * rBx - vAy - wA * rAx;
+
+				// Compute normal impulse
+				b2FloatW vn = dvx * normalX + dvy * normalY;
+				b2FloatW lambda = -(b2LoadW(cp->normalMass) * (vn - b2LoadW(cp->velocityBias)));
+
+				// Clamp the accumulated impulse
+				b2FloatW oldImpulse = b2LoadW(cp->normalImpulse);
+				b2FloatW newImpulse = b2MaxW(oldImpulse + lambda, zero);
+				lambda = newImpulse - oldImpulse;
+				b2StoreW(cp->normalImpulse, newImpulse);
+
+				// Apply contact impulse
+				b2FloatW Px = lambda * normalX;
+				b2FloatW Py = lambda * normalY;
+
+				vAx = vAx - mA * Px;
+				vAy = vAy - mA * Py;
+				wA = wA - iA * (rAx * Py - rAy * Px);
+
+				vBx = vBx + mB * Px;
+				vBy = vBy + mB * Py;
+				wB = wB + iB * (rBx * Py - rBy * Px);
+			}
+		}
+		else
+		{
+			b2WideConstraintPoint* cp1 = wc->points + 0;
+			b2WideConstraintPoint* cp2 = wc->points + 1;
+			b2FloatW r1Ax = b2LoadW(cp1->rAx);
+			b2FloatW r1Ay = b2LoadW(cp1->rAy);
+			b2FloatW r1Bx = b2LoadW(cp1->rBx);
+			b2FloatW r1By = b2LoadW(cp1->rBy);
+			b2FloatW r2Ax = b2LoadW(cp2->rAx);
+			b2FloatW r2Ay = b2LoadW(cp2->rAy);
+			b2FloatW r2Bx = b2LoadW(cp2->rBx);
+			b2FloatW r2By = b2LoadW(cp2->rBy);
+
+			b2FloatW a1 = b2LoadW(cp1->normalImpulse);
+			b2FloatW a2 = b2LoadW(cp2->normalImpulse);
+
+			// Relative velocity at contact
+			b2FloatW dv1x = vBx - wB * r1By - vAx + wA * r1Ay;
+			b2FloatW dv1y = vBy + wB * r1Bx - vAy - wA * r1Ax;
+			b2FloatW dv2x = vBx - wB * r2By - vAx + wA * r2Ay;
+			b2FloatW dv2y = vBy + wB * r2Bx - vAy - wA * r2Ax;
+
+			// Compute normal velocity
+			b2FloatW vn1 = dv1x * normalX + dv1y * normalY;
+			b2FloatW vn2 = dv2x * normalX + dv2y * normalY;
+
+			// Compute b'
+			b2FloatW k11 = b2LoadW(wc->k11);
+			b2FloatW k12 = b2LoadW(wc->k12);
+			b2FloatW k22 = b2LoadW(wc->k22);
+			b2FloatW bx = vn1 - b2LoadW(cp1->velocityBias) - (k11 * a1 + k12 * a2);
+			b2FloatW by = vn2 - b2LoadW(cp2->velocityBias) - (k12 * a1 + k22 * a2);
+
+			// Case 1: vn = 0
+			b2FloatW x1 = -(b2LoadW(wc->normalMass11) * bx + b2LoadW(wc->normalMass12) * by);
+			b2FloatW x2 = -(b2LoadW(wc->normalMass21) * bx + b2LoadW(wc->normalMass22) * by);
+			b2MaskW case1 = b2AndW(b2GreaterEqualW(x1, zero), b2GreaterEqualW(x2, zero));
+
+			// Case 2: vn1 = 0 and x2 = 0
+			b2FloatW x1Case2 = -(b2LoadW(cp1->normalMass) * bx);
+			b2FloatW vn2Case2 = k12 * x1Case2 + by;
+			b2MaskW case2 = b2AndW(b2GreaterEqualW(x1Case2, zero), b2GreaterEqualW(vn2Case2, zero));
+
+			// Case 3: vn2 = 0 and x1 = 0
+			b2FloatW x2Case3 = -(b2LoadW(cp2->normalMass) * by);
+			b2FloatW vn1Case3 = k12 * x2Case3 + bx;
+			b2MaskW case3 = b2AndW(b2GreaterEqualW(x2Case3, zero), b2GreaterEqualW(vn1Case3, zero));
+
+			// Case 4: x1 = 0 and x2 = 0
+			b2MaskW case4 = b2AndW(b2GreaterEqualW(bx, zero), b2GreaterEqualW(by, zero));
+
+			// Take the first case that holds. If none does the impulse is left
+			// alone, as in the scalar solver.
+			b2FloatW newX1 = b2SelectW(case4, zero, a1);
+			b2FloatW newX2 = b2SelectW(case4, zero, a2);
+			newX1 = b2SelectW(case3, zero, newX1);
+			newX2 = b2SelectW(case3, x2Case3, newX2);
+			newX1 = b2SelectW(case2, x1Case2, newX1);
+			newX2 = b2SelectW(case2, zero, newX2);
+			newX1 = b2SelectW(case1, x1, newX1);
+			newX2 = b2SelectW(case1, x2, newX2);
+
+			// Get the incremental impulse
+			b2FloatW d1 = newX1 - a1;
+			b2FloatW d2 = newX2 - a2;
+
+			// Apply incremental impulse
+			b2FloatW P1x = d1 * normalX;
+			b2FloatW P1y = d1 * normalY;
+			b2FloatW P2x = d2 * normalX;
+			b2FloatW P2y = d2 * normalY;
+
+			vAx = vAx - mA * (P1x + P2x);
+			vAy = vAy - mA * (P1y + P2y);
+			wA = wA - iA * ((r1Ax * P1y - r1Ay * P1x) + (r2Ax * P2y - r2Ay * P2x));
+
+			vBx = vBx + mB * (P1x + P2x);
+			vBy = vBy + mB * (P1y + P2y);
+			wB = wB + iB * ((r1Bx * P1y - r1By * P1x) + (r2Bx * P2y - r2By * P2x));
+
+			// Accumulate
+			b2StoreW(cp1->normalImpulse, newX1);
+			b2StoreW(cp2->normalImpulse, newX2);
+		}
+
+		b2ScatterVelocities(m_velocities, wc->indexA, wc->writeA, vAx, vAy, wA);
+		b2ScatterVelocities(m_velocities, wc->indexB, wc->writeB, vBx, vBy, wB);
+	}
+
+	for (int32 i = 0; i < m_scalarCount; ++i)
+	{
+		SolveVelocityConstraint(m_velocityConstraints + m_scalarIndices[i]);
 	}
 }
 
 void b2ContactSolver::StoreImpulses()
 {
+	// Bring the wide solver's impulses back for warm starting and reporting.
+	for (int32 i = 0; i < m_wideCount; ++i)
+	{
+		const b2WideContactConstraint* wc = m_wideConstraints + i;
+		for (int32 lane = 0; lane < b2_simdWidth; ++lane)
+		{
+			if (wc->constraintIndex[lane] < 0)
+			{
+				continue;
+			}
+
+			b2ContactVelocityConstraint* vc = m_velocityConstraints + wc->constraintIndex[lane];
+			for (int32 j = 0; j < vc->pointCount; ++j)
+			{
+				vc->points[j].normalImpulse = wc->points[j].normalImpulse[lane];
+				vc->points[j].tangentImpulse = wc->points[j].tangentImpulse[lane];
+			}
+		}
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
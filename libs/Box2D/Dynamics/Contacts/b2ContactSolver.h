@@ -27,6 +27,7 @@ class b2Contact;
 class b2Body;
 class b2StackAllocator;
 struct b2ContactPositionConstraint;
+struct b2WideContactConstraint;
 
 struct b2VelocityConstraintPoint
 {
@@ -64,6 +65,7 @@ struct b2ContactSolverDef
 	b2Position* positions;
 	b2Velocity* velocities;
 	b2StackAllocator* allocator;
+	const b2Island* island;
 };
 
 class b2ContactSolver
@@ -81,6 +83,12 @@ public:
 	bool SolvePositionConstraints();
 	bool SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB);
 
+	void SolveVelocityConstraint(b2ContactVelocityConstraint* vc);
+
+	// The SIMD solver, used when m_step.wideSolver is set.
+	void InitializeWideConstraints();
+	void SolveWideVelocityConstraints();
+
 	b2TimeStep m_step;
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
@@ -89,6 +97,14 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+	int32 m_bodyCount;
+
+	// Batches for the SIMD solver, and the constraints it leaves to the
+	// scalar solver. NULL unless the wide solver is in use.
+	b2WideContactConstraint* m_wideConstraints;
+	int32 m_wideCount;
+	int32* m_scalarIndices;
+	int32 m_scalarCount;
 };
 
 #endif
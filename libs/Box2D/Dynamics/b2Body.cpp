@@ -123,6 +123,7 @@ void b2Body::SetType(b2BodyType type)
 		return;
 	}
 
+	bool wasStatic = m_type == b2_staticBody;
 	m_type = type;
 
 	ResetMassData();
@@ -155,6 +156,17 @@ void b2Body::SetType(b2BodyType type)
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
+		// Static proxies live in a separate tree, so recreate the proxies when
+		// the body becomes static or stops being static. New proxies are
+		// buffered as moved already. This also creates any proxies a static
+		// batch has not created yet.
+		if (wasStatic != (m_type == b2_staticBody) && (m_flags & e_activeFlag))
+		{
+			f->DestroyProxies(broadPhase);
+			f->CreateProxies(broadPhase, m_xf);
+			continue;
+		}
+
 		int32 proxyCount = f->m_proxyCount;
 		for (int32 i = 0; i < proxyCount; ++i)
 		{
@@ -177,7 +189,14 @@ b2Fixture* b2Body::CreateFixture(const b2FixtureDef* def)
 	b2Fixture* fixture = new (memory) b2Fixture;
 	fixture->Create(allocator, this, def);
 
-	if (m_flags & e_activeFlag)
+	// In a static batch the world creates the proxies of static fixtures
+	// later, all at once.
+	bool batched = m_type == b2_staticBody && (m_world->m_flags & b2World::e_staticBatch);
+	if ((m_flags & e_activeFlag) && batched)
+	{
+		++m_world->m_batchedFixtureCount;
+	}
+	else if (m_flags & e_activeFlag)
 	{
 		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 		fixture->CreateProxies(broadPhase, m_xf);
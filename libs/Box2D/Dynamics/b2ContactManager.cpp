@@ -21,17 +21,21 @@
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
+#include <Box2D/Common/b2StackAllocator.h>
+#include <Box2D/Common/b2ThreadPool.h>
 
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
 
-b2ContactManager::b2ContactManager()
+b2ContactManager::b2ContactManager(b2BroadPhaseType broadPhaseType) : m_broadPhase(broadPhaseType)
 {
 	m_contactList = NULL;
 	m_contactCount = 0;
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = NULL;
+	m_taskExecutor = NULL;
+	m_stackAllocator = NULL;
 }
 
 void b2ContactManager::Destroy(b2Contact* c)
@@ -99,74 +103,178 @@ void b2ContactManager::Destroy(b2Contact* c)
 	--m_contactCount;
 }
 
-// This is the top level collision call for the time step. Here
-// all the narrow phase collision is processed for the world
-// contact list.
-void b2ContactManager::Collide()
+// The number of contacts per narrow phase work item.
+const int32 b2_contactUpdateBlockSize = 64;
+
+// A contact in the parallel narrow phase and what is needed to report its
+// update afterwards. Deferred contacts are handled serially instead.
+struct b2ContactUpdate
 {
-	// Update awake contacts.
-	b2Contact* c = m_contactList;
-	while (c)
+	b2Contact* contact;
+	b2Manifold oldManifold;
+	bool wasTouching;
+	bool deferred;
+};
+
+class b2ContactUpdateTask : public b2Task
+{
+public:
+	void Execute(int32 index, int32 threadIndex)
 	{
-		b2Fixture* fixtureA = c->GetFixtureA();
-		b2Fixture* fixtureB = c->GetFixtureB();
-		int32 indexA = c->GetChildIndexA();
-		int32 indexB = c->GetChildIndexB();
-		b2Body* bodyA = fixtureA->GetBody();
-		b2Body* bodyB = fixtureB->GetBody();
-		 
-		// Is this contact flagged for filtering?
-		if (c->m_flags & b2Contact::e_filterFlag)
-		{
-			// Should these bodies collide?
-			if (bodyB->ShouldCollide(bodyA) == false)
-			{
-				b2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
-				continue;
-			}
+		B2_NOT_USED(threadIndex);
 
-			// Check user filtering.
-			if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
+		int32 begin = index * b2_contactUpdateBlockSize;
+		int32 end = b2Min(begin + b2_contactUpdateBlockSize, count);
+		for (int32 i = begin; i < end; ++i)
+		{
+			b2ContactUpdate* update = updates + i;
+			if (update->deferred)
 			{
-				b2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
 				continue;
 			}
 
-			// Clear the filtering flag.
-			c->m_flags &= ~b2Contact::e_filterFlag;
+			update->wasTouching = update->contact->UpdateManifold(&update->oldManifold);
 		}
+	}
+
+	b2ContactUpdate* updates;
+	int32 count;
+};
+
+bool b2ContactManager::PrepareUpdate(b2Contact* c)
+{
+	b2Fixture* fixtureA = c->GetFixtureA();
+	b2Fixture* fixtureB = c->GetFixtureB();
+	int32 indexA = c->GetChildIndexA();
+	int32 indexB = c->GetChildIndexB();
+	b2Body* bodyA = fixtureA->GetBody();
+	b2Body* bodyB = fixtureB->GetBody();
 
-		bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
-		bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+	// Is this contact flagged for filtering?
+	if (c->m_flags & b2Contact::e_filterFlag)
+	{
+		// Should these bodies collide?
+		if (bodyB->ShouldCollide(bodyA) == false)
+		{
+			Destroy(c);
+			return false;
+		}
 
-		// At least one body must be awake and it must be dynamic or kinematic.
-		if (activeA == false && activeB == false)
+		// Check user filtering.
+		if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
 		{
-			c = c->GetNext();
-			continue;
+			Destroy(c);
+			return false;
 		}
 
-		int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
-		int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
-		bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+		// Clear the filtering flag.
+		c->m_flags &= ~b2Contact::e_filterFlag;
+	}
+
+	bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
+	bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+
+	// At least one body must be awake and it must be dynamic or kinematic.
+	if (activeA == false && activeB == false)
+	{
+		return false;
+	}
+
+	int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
+	int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
+	bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+
+	// Here we destroy contacts that cease to overlap in the broad-phase.
+	if (overlap == false)
+	{
+		Destroy(c);
+		return false;
+	}
+
+	return true;
+}
+
+bool b2ContactManager::CanUpdate(b2Contact* c) const
+{
+	if (c->m_flags & b2Contact::e_filterFlag)
+	{
+		return false;
+	}
+
+	b2Fixture* fixtureA = c->GetFixtureA();
+	b2Fixture* fixtureB = c->GetFixtureB();
+	b2Body* bodyA = fixtureA->GetBody();
+	b2Body* bodyB = fixtureB->GetBody();
 
-		// Here we destroy contacts that cease to overlap in the broad-phase.
-		if (overlap == false)
+	bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
+	bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+	if (activeA == false && activeB == false)
+	{
+		return false;
+	}
+
+	int32 proxyIdA = fixtureA->m_proxies[c->GetChildIndexA()].proxyId;
+	int32 proxyIdB = fixtureB->m_proxies[c->GetChildIndexB()].proxyId;
+	return m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+}
+
+// This is the top level collision call for the time step. Here
+// all the narrow phase collision is processed for the world
+// contact list.
+void b2ContactManager::Collide()
+{
+	if (m_taskExecutor == NULL || m_taskExecutor->GetThreadCount() < 2)
+	{
+		// Update awake contacts.
+		b2Contact* c = m_contactList;
+		while (c)
 		{
-			b2Contact* cNuke = c;
-			c = cNuke->GetNext();
-			Destroy(cNuke);
-			continue;
+			b2Contact* next = c->GetNext();
+			if (PrepareUpdate(c))
+			{
+				// The contact persists.
+				c->Update(m_contactListener);
+			}
+			c = next;
 		}
+		return;
+	}
 
-		// The contact persists.
-		c->Update(m_contactListener);
-		c = c->GetNext();
+	// Update the manifolds of the contacts that certainly persist in
+	// parallel, then go through the list in order to wake bodies and call
+	// the listener. Everything else is deferred to that pass and handled as
+	// above, since filtering, destroying and a body woken by an earlier
+	// contact all depend on list order.
+	int32 count = m_contactCount;
+	b2ContactUpdate* updates = (b2ContactUpdate*)m_stackAllocator->Allocate(count * sizeof(b2ContactUpdate));
+	int32 i = 0;
+	for (b2Contact* c = m_contactList; c; c = c->GetNext())
+	{
+		b2ContactUpdate* update = updates + i++;
+		update->contact = c;
+		update->deferred = CanUpdate(c) == false;
 	}
+
+	b2ContactUpdateTask task;
+	task.updates = updates;
+	task.count = count;
+	m_taskExecutor->ParallelFor(&task, (count + b2_contactUpdateBlockSize - 1) / b2_contactUpdateBlockSize);
+
+	for (i = 0; i < count; ++i)
+	{
+		b2ContactUpdate* update = updates + i;
+		b2Contact* c = update->contact;
+		if (update->deferred == false)
+		{
+			c->ReportUpdate(m_contactListener, &update->oldManifold, update->wasTouching);
+		}
+		else if (PrepareUpdate(c))
+		{
+			c->Update(m_contactListener);
+		}
+	}
+
+	m_stackAllocator->Free(updates);
 }
 
 void b2ContactManager::FindNewContacts()
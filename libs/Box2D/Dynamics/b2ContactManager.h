@@ -25,12 +25,14 @@ class b2Contact;
 class b2ContactFilter;
 class b2ContactListener;
 class b2BlockAllocator;
+class b2StackAllocator;
+class b2TaskExecutor;
 
 // Delegate of b2World.
 class b2ContactManager
 {
 public:
-	b2ContactManager();
+	b2ContactManager(b2BroadPhaseType broadPhaseType);
 
 	// Broad-phase callback.
 	void AddPair(void* proxyUserDataA, void* proxyUserDataB);
@@ -40,6 +42,13 @@ public:
 	void Destroy(b2Contact* c);
 
 	void Collide();
+
+	// Returns true if c persists and needs its manifold updated. Destroys c
+	// if it was filtered out or its proxies no longer overlap.
+	bool PrepareUpdate(b2Contact* c);
+
+	// True if PrepareUpdate would return true without destroying anything.
+	bool CanUpdate(b2Contact* c) const;
             
 	b2BroadPhase m_broadPhase;
 	b2Contact* m_contactList;
@@ -47,6 +56,10 @@ public:
 	b2ContactFilter* m_contactFilter;
 	b2ContactListener* m_contactListener;
 	b2BlockAllocator* m_allocator;
+
+	// When set, contact manifolds are updated in parallel.
+	b2TaskExecutor* m_taskExecutor;
+	b2StackAllocator* m_stackAllocator;
 };
 
 #endif
@@ -26,6 +26,7 @@
 #include <Box2D/Dynamics/Joints/b2Joint.h>
 #include <Box2D/Common/b2StackAllocator.h>
 #include <Box2D/Common/b2Timer.h>
+#include <string.h>
 
 /*
 Position Correction Notes
@@ -158,6 +159,7 @@ b2Island::b2Island(
 	m_bodyCount = 0;
 	m_contactCount = 0;
 	m_jointCount = 0;
+	m_staticCount = 0;
 
 	m_allocator = allocator;
 	m_listener = listener;
@@ -168,11 +170,21 @@ b2Island::b2Island(
 
 	m_velocities = (b2Velocity*)m_allocator->Allocate(m_bodyCapacity * sizeof(b2Velocity));
 	m_positions = (b2Position*)m_allocator->Allocate(m_bodyCapacity * sizeof(b2Position));
+	m_staticSlots = (int32*)m_allocator->Allocate(m_bodyCapacity * sizeof(int32));
+
+	uint32 tableCapacity = b2NextPowerOfTwo(2 * m_bodyCapacity);
+	m_staticTableMask = tableCapacity - 1;
+	m_staticTable = (int32*)m_allocator->Allocate(tableCapacity * sizeof(int32));
+	memset(m_staticTable, 0xff, tableCapacity * sizeof(int32));
+
+	m_impulses = NULL;
 }
 
 b2Island::~b2Island()
 {
 	// Warning: the order should reverse the constructor order.
+	m_allocator->Free(m_staticTable);
+	m_allocator->Free(m_staticSlots);
 	m_allocator->Free(m_positions);
 	m_allocator->Free(m_velocities);
 	m_allocator->Free(m_joints);
@@ -196,9 +208,13 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		b2Vec2 v = b->m_linearVelocity;
 		float32 w = b->m_angularVelocity;
 
-		// Store positions for continuous collision.
-		b->m_sweep.c0 = b->m_sweep.c;
-		b->m_sweep.a0 = b->m_sweep.a;
+		// Store positions for continuous collision. Static bodies never move,
+		// so theirs are left alone; they may be shared with other islands.
+		if (b->m_type != b2_staticBody)
+		{
+			b->m_sweep.c0 = b->m_sweep.c;
+			b->m_sweep.a0 = b->m_sweep.a;
+		}
 
 		if (b->m_type == b2_dynamicBody)
 		{
@@ -230,6 +246,7 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	solverData.step = step;
 	solverData.positions = m_positions;
 	solverData.velocities = m_velocities;
+	solverData.island = this;
 
 	// Initialize velocity constraints.
 	b2ContactSolverDef contactSolverDef;
@@ -239,6 +256,7 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	contactSolverDef.positions = m_positions;
 	contactSolverDef.velocities = m_velocities;
 	contactSolverDef.allocator = m_allocator;
+	contactSolverDef.island = this;
 
 	b2ContactSolver contactSolver(&contactSolverDef);
 	contactSolver.InitializeVelocityConstraints();
@@ -326,10 +344,16 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		}
 	}
 
-	// Copy state buffers back to the bodies
+	// Copy state buffers back to the bodies. The solver never moves static
+	// bodies.
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
 		b2Body* body = m_bodies[i];
+		if (body->m_type == b2_staticBody)
+		{
+			continue;
+		}
+
 		body->m_sweep.c = m_positions[i].c;
 		body->m_sweep.a = m_positions[i].a;
 		body->m_linearVelocity = m_velocities[i].v;
@@ -375,7 +399,10 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 			for (int32 i = 0; i < m_bodyCount; ++i)
 			{
 				b2Body* b = m_bodies[i];
-				b->SetAwake(false);
+				if (b->GetType() != b2_staticBody)
+				{
+					b->SetAwake(false);
+				}
 			}
 		}
 	}
@@ -403,6 +430,7 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 	contactSolverDef.step = subStep;
 	contactSolverDef.positions = m_positions;
 	contactSolverDef.velocities = m_velocities;
+	contactSolverDef.island = this;
 	b2ContactSolver contactSolver(&contactSolverDef);
 
 	// Solve position constraints.
@@ -520,6 +548,23 @@ void b2Island::Report(const b2ContactVelocityConstraint* constraints)
 		return;
 	}
 
+	if (m_impulses != NULL)
+	{
+		for (int32 i = 0; i < m_contactCount; ++i)
+		{
+			const b2ContactVelocityConstraint* vc = constraints + i;
+
+			b2ContactImpulse* impulse = m_impulses + i;
+			impulse->count = vc->pointCount;
+			for (int32 j = 0; j < vc->pointCount; ++j)
+			{
+				impulse->normalImpulses[j] = vc->points[j].normalImpulse;
+				impulse->tangentImpulses[j] = vc->points[j].tangentImpulse;
+			}
+		}
+		return;
+	}
+
 	for (int32 i = 0; i < m_contactCount; ++i)
 	{
 		b2Contact* c = m_contacts[i];
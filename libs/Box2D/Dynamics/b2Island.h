@@ -27,6 +27,7 @@ class b2Contact;
 class b2Joint;
 class b2StackAllocator;
 class b2ContactListener;
+struct b2ContactImpulse;
 struct b2ContactVelocityConstraint;
 struct b2Profile;
 
@@ -43,6 +44,12 @@ public:
 		m_bodyCount = 0;
 		m_contactCount = 0;
 		m_jointCount = 0;
+
+		for (int32 i = 0; i < m_staticCount; ++i)
+		{
+			m_staticTable[m_staticSlots[i]] = -1;
+		}
+		m_staticCount = 0;
 	}
 
 	void Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep);
@@ -52,7 +59,21 @@ public:
 	void Add(b2Body* body)
 	{
 		b2Assert(m_bodyCount < m_bodyCapacity);
-		body->m_islandIndex = m_bodyCount;
+
+		// Static bodies can be in several islands that are solved at the
+		// same time, so their index is kept here rather than on the body.
+		if (body->m_type == b2_staticBody)
+		{
+			int32 slot = FindStaticSlot(body);
+			b2Assert(m_staticTable[slot] == -1);
+			m_staticTable[slot] = m_bodyCount;
+			m_staticSlots[m_staticCount++] = slot;
+		}
+		else
+		{
+			body->m_islandIndex = m_bodyCount;
+		}
+
 		m_bodies[m_bodyCount] = body;
 		++m_bodyCount;
 	}
@@ -69,6 +90,34 @@ public:
 		m_joints[m_jointCount++] = joint;
 	}
 
+	/// Get the index of a body in this island's solver arrays.
+	int32 GetIndex(const b2Body* body) const
+	{
+		if (body->m_type != b2_staticBody)
+		{
+			return body->m_islandIndex;
+		}
+
+		// Every body that a contact or joint of this island touches was
+		// added to it, including the ground bodies of a gear joint.
+		int32 index = m_staticTable[FindStaticSlot(body)];
+		b2Assert(index != -1);
+		return index;
+	}
+
+	/// Find the slot of a static body in the table, or the empty slot it
+	/// would go in. The table is at most half full, so probes stay short.
+	int32 FindStaticSlot(const b2Body* body) const
+	{
+		uint32 slot = (uint32)((size_t)body >> 4) * 2654435761u;
+		slot &= m_staticTableMask;
+		while (m_staticTable[slot] != -1 && m_bodies[m_staticTable[slot]] != body)
+		{
+			slot = (slot + 1) & m_staticTableMask;
+		}
+		return slot;
+	}
+
 	void Report(const b2ContactVelocityConstraint* constraints);
 
 	b2StackAllocator* m_allocator;
@@ -81,9 +130,20 @@ public:
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
 
+	// Open addressed table from static body to its index in m_bodies, with
+	// -1 for empty slots. m_staticSlots lists the used slots for Clear.
+	int32* m_staticTable;
+	int32* m_staticSlots;
+	uint32 m_staticTableMask;
+
+	// When set, Report stores the impulses here, one per contact, instead
+	// of calling the listener.
+	b2ContactImpulse* m_impulses;
+
 	int32 m_bodyCount;
 	int32 m_jointCount;
 	int32 m_contactCount;
+	int32 m_staticCount;
 
 	int32 m_bodyCapacity;
 	int32 m_contactCapacity;
@@ -21,7 +21,9 @@
 
 #include <Box2D/Common/b2Math.h>
 
-/// Profiling data. Times are in milliseconds.
+class b2Island;
+
+/// Profiling data. Times are in milliseconds, sizes in bytes.
 struct b2Profile
 {
 	float32 step;
@@ -32,6 +34,10 @@ struct b2Profile
 	float32 solvePosition;
 	float32 broadphase;
 	float32 solveTOI;
+
+	// Stack allocator use during the step, over the allocators of all threads.
+	int32 stackPeak;		// the most bytes in use at once on any one thread
+	int32 stackGrowCount;	// heap allocations made to grow the stacks
 };
 
 /// This is an internal structure.
@@ -43,6 +49,7 @@ struct b2TimeStep
 	int32 velocityIterations;
 	int32 positionIterations;
 	bool warmStarting;
+	bool wideSolver;
 };
 
 /// This is an internal structure.
@@ -65,6 +72,7 @@ struct b2SolverData
 	b2TimeStep step;
 	b2Position* positions;
 	b2Velocity* velocities;
+	const b2Island* island;
 };
 
 #endif
@@ -31,10 +31,12 @@
 #include <Box2D/Collision/Shapes/b2PolygonShape.h>
 #include <Box2D/Collision/b2TimeOfImpact.h>
 #include <Box2D/Common/b2Draw.h>
+#include <Box2D/Common/b2ThreadPool.h>
 #include <Box2D/Common/b2Timer.h>
 #include <new>
+#include <string.h>
 
-b2World::b2World(const b2Vec2& gravity)
+b2World::b2World(const b2Vec2& gravity, b2BroadPhaseType broadPhaseType) : m_contactManager(broadPhaseType)
 {
 	m_destructionListener = NULL;
 	g_debugDraw = NULL;
@@ -48,6 +50,7 @@ b2World::b2World(const b2Vec2& gravity)
 	m_warmStarting = true;
 	m_continuousPhysics = true;
 	m_subStepping = false;
+	m_wideSolver = false;
 
 	m_stepComplete = true;
 
@@ -55,10 +58,16 @@ b2World::b2World(const b2Vec2& gravity)
 	m_gravity = gravity;
 
 	m_flags = e_clearForces;
+	m_batchedFixtureCount = 0;
 
 	m_inv_dt0 = 0.0f;
 
 	m_contactManager.m_allocator = &m_blockAllocator;
+	m_contactManager.m_stackAllocator = &m_stackAllocator;
+
+	m_taskExecutor = NULL;
+	m_workerAllocators = NULL;
+	m_workerAllocatorCount = 0;
 
 	memset(&m_profile, 0, sizeof(b2Profile));
 }
@@ -82,6 +91,21 @@ b2World::~b2World()
 
 		b = bNext;
 	}
+
+	DestroyWorkerAllocators();
+}
+
+void b2World::DestroyWorkerAllocators()
+{
+	for (int32 i = 0; i < m_workerAllocatorCount; ++i)
+	{
+		m_workerAllocators[i]->~b2StackAllocator();
+		b2Free(m_workerAllocators[i]);
+	}
+	b2Free(m_workerAllocators);
+
+	m_workerAllocators = NULL;
+	m_workerAllocatorCount = 0;
 }
 
 void b2World::SetDestructionListener(b2DestructionListener* listener)
@@ -104,6 +128,33 @@ void b2World::SetDebugDraw(b2Draw* debugDraw)
 	g_debugDraw = debugDraw;
 }
 
+void b2World::SetTaskExecutor(b2TaskExecutor* executor)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	DestroyWorkerAllocators();
+	m_taskExecutor = executor;
+	m_contactManager.m_taskExecutor = executor;
+	if (executor == NULL || executor->GetThreadCount() < 2)
+	{
+		return;
+	}
+
+	// Each extra thread needs its own stack allocator. They are large, so
+	// they live on the heap rather than in the world.
+	m_workerAllocatorCount = executor->GetThreadCount() - 1;
+	m_workerAllocators = (b2StackAllocator**)b2Alloc(m_workerAllocatorCount * sizeof(b2StackAllocator*));
+	for (int32 i = 0; i < m_workerAllocatorCount; ++i)
+	{
+		void* mem = b2Alloc(sizeof(b2StackAllocator));
+		m_workerAllocators[i] = new (mem) b2StackAllocator;
+	}
+}
+
 b2Body* b2World::CreateBody(const b2BodyDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -128,6 +179,107 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 	return b;
 }
 
+void b2World::BeginStaticBatch()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	m_flags |= e_staticBatch;
+}
+
+void b2World::EndStaticBatch()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked() || (m_flags & e_staticBatch) == 0)
+	{
+		return;
+	}
+
+	m_flags &= ~e_staticBatch;
+
+	// Nothing was deferred, so skip the walk over every body.
+	int32 batchedFixtureCount = m_batchedFixtureCount;
+	m_batchedFixtureCount = 0;
+	if (batchedFixtureCount == 0)
+	{
+		return;
+	}
+
+	// Find the fixtures the batch left without proxies. Walking the bodies
+	// rather than remembering the fixtures copes with anything destroyed,
+	// deactivated or made non-static during the batch.
+	int32 proxyCount = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->m_type != b2_staticBody || b->IsActive() == false)
+		{
+			continue;
+		}
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			if (f->m_proxyCount == 0)
+			{
+				proxyCount += f->m_shape->GetChildCount();
+			}
+		}
+	}
+
+	if (proxyCount == 0)
+	{
+		return;
+	}
+
+	b2AABB* aabbs = (b2AABB*)b2Alloc(proxyCount * sizeof(b2AABB));
+	void** proxies = (void**)b2Alloc(proxyCount * sizeof(void*));
+	int32* proxyIds = (int32*)b2Alloc(proxyCount * sizeof(int32));
+
+	int32 count = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->m_type != b2_staticBody || b->IsActive() == false)
+		{
+			continue;
+		}
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			if (f->m_proxyCount > 0)
+			{
+				continue;
+			}
+
+			f->m_proxyCount = f->m_shape->GetChildCount();
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				b2FixtureProxy* proxy = f->m_proxies + i;
+				f->m_shape->ComputeAABB(&proxy->aabb, b->m_xf, i);
+				proxy->fixture = f;
+				proxy->childIndex = i;
+
+				aabbs[count] = proxy->aabb;
+				proxies[count] = proxy;
+				++count;
+			}
+		}
+	}
+
+	m_contactManager.m_broadPhase.CreateProxies(aabbs, proxies, count, true, proxyIds);
+	for (int32 i = 0; i < count; ++i)
+	{
+		((b2FixtureProxy*)proxies[i])->proxyId = proxyIds[i];
+	}
+
+	b2Free(proxyIds);
+	b2Free(proxies);
+	b2Free(aabbs);
+
+	m_flags |= e_newFixture;
+}
+
 void b2World::DestroyBody(b2Body* b)
 {
 	b2Assert(m_bodyCount > 0);
@@ -383,19 +535,66 @@ void b2World::SetAllowSleeping(bool flag)
 }
 
 // Find islands, integrate and solve constraints, solve position constraints
+// The bodies, contacts and joints of one island, as ranges of the arrays
+// filled in by b2World::Solve.
+struct b2IslandRange
+{
+	int32 bodyStart, bodyCount;
+	int32 contactStart, contactCount;
+	int32 jointStart, jointCount;
+};
+
+// Solves one collected island per work item. Each thread gets its own stack
+// allocator and contact impulses are buffered so the listener can be called
+// afterwards in a fixed order.
+class b2IslandSolveTask : public b2Task
+{
+public:
+	void Execute(int32 index, int32 threadIndex)
+	{
+		const b2IslandRange& range = ranges[index];
+		b2StackAllocator* allocator = threadIndex == 0 ? mainAllocator : workerAllocators[threadIndex - 1];
+
+		b2Island island(range.bodyCount, range.contactCount, range.jointCount, allocator, listener);
+		for (int32 i = 0; i < range.bodyCount; ++i)
+		{
+			island.Add(bodies[range.bodyStart + i]);
+		}
+		for (int32 i = 0; i < range.contactCount; ++i)
+		{
+			island.Add(contacts[range.contactStart + i]);
+		}
+		for (int32 i = 0; i < range.jointCount; ++i)
+		{
+			island.Add(joints[range.jointStart + i]);
+		}
+
+		island.m_impulses = impulses + range.contactStart;
+		island.Solve(profiles + index, *step, gravity, allowSleep);
+	}
+
+	const b2IslandRange* ranges;
+	b2Body** bodies;
+	b2Contact** contacts;
+	b2Joint** joints;
+	b2ContactImpulse* impulses;
+	b2Profile* profiles;
+
+	b2StackAllocator* mainAllocator;
+	b2StackAllocator** workerAllocators;
+	b2ContactListener* listener;
+
+	const b2TimeStep* step;
+	b2Vec2 gravity;
+	bool allowSleep;
+};
+
 void b2World::Solve(const b2TimeStep& step)
 {
 	m_profile.solveInit = 0.0f;
 	m_profile.solveVelocity = 0.0f;
 	m_profile.solvePosition = 0.0f;
 
-	// Size the island for the worst case.
-	b2Island island(m_bodyCount,
-					m_contactManager.m_contactCount,
-					m_jointCount,
-					&m_stackAllocator,
-					m_contactManager.m_contactListener);
-
 	// Clear all the island flags.
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
@@ -410,7 +609,24 @@ void b2World::Solve(const b2TimeStep& step)
 		j->m_islandFlag = false;
 	}
 
-	// Build and simulate all awake islands.
+	// Collect all awake islands first, then solve them. A static body can
+	// appear in several islands, at most once per contact or joint touching it.
+	int32 contactCapacity = m_contactManager.m_contactCount;
+	int32 bodyCapacity = m_bodyCount + contactCapacity + m_jointCount;
+	b2Body** islandBodies = (b2Body**)m_stackAllocator.Allocate(bodyCapacity * sizeof(b2Body*));
+	b2Contact** islandContacts = (b2Contact**)m_stackAllocator.Allocate(contactCapacity * sizeof(b2Contact*));
+	b2Joint** islandJoints = (b2Joint**)m_stackAllocator.Allocate(m_jointCount * sizeof(b2Joint*));
+	b2IslandRange* ranges = (b2IslandRange*)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2IslandRange));
+	int32 bodyCount = 0;
+	int32 contactCount = 0;
+	int32 jointCount = 0;
+	int32 islandCount = 0;
+
+	// The largest island, for sizing the serial solver.
+	int32 maxBodyCount = 0;
+	int32 maxContactCount = 0;
+	int32 maxJointCount = 0;
+
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
 	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
@@ -431,8 +647,12 @@ void b2World::Solve(const b2TimeStep& step)
 			continue;
 		}
 
-		// Reset island and stack.
-		island.Clear();
+		b2IslandRange* range = ranges + islandCount++;
+		range->bodyStart = bodyCount;
+		range->contactStart = contactCount;
+		range->jointStart = jointCount;
+
+		// Reset stack.
 		int32 stackCount = 0;
 		stack[stackCount++] = seed;
 		seed->m_flags |= b2Body::e_islandFlag;
@@ -443,7 +663,8 @@ void b2World::Solve(const b2TimeStep& step)
 			// Grab the next body off the stack and add it to the island.
 			b2Body* b = stack[--stackCount];
 			b2Assert(b->IsActive() == true);
-			island.Add(b);
+			b2Assert(bodyCount < bodyCapacity);
+			islandBodies[bodyCount++] = b;
 
 			// Make sure the body is awake.
 			b->SetAwake(true);
@@ -481,7 +702,7 @@ void b2World::Solve(const b2TimeStep& step)
 					continue;
 				}
 
-				island.Add(contact);
+				islandContacts[contactCount++] = contact;
 				contact->m_flags |= b2Contact::e_islandFlag;
 
 				b2Body* other = ce->other;
@@ -513,7 +734,7 @@ void b2World::Solve(const b2TimeStep& step)
 					continue;
 				}
 
-				island.Add(je->joint);
+				islandJoints[jointCount++] = je->joint;
 				je->joint->m_islandFlag = true;
 
 				if (other->m_flags & b2Body::e_islandFlag)
@@ -527,17 +748,17 @@ void b2World::Solve(const b2TimeStep& step)
 			}
 		}
 
-		b2Profile profile;
-		island.Solve(&profile, step, m_gravity, m_allowSleep);
-		m_profile.solveInit += profile.solveInit;
-		m_profile.solveVelocity += profile.solveVelocity;
-		m_profile.solvePosition += profile.solvePosition;
+		range->bodyCount = bodyCount - range->bodyStart;
+		range->contactCount = contactCount - range->contactStart;
+		range->jointCount = jointCount - range->jointStart;
+		maxBodyCount = b2Max(maxBodyCount, range->bodyCount);
+		maxContactCount = b2Max(maxContactCount, range->contactCount);
+		maxJointCount = b2Max(maxJointCount, range->jointCount);
 
-		// Post solve cleanup.
-		for (int32 i = 0; i < island.m_bodyCount; ++i)
+		// Allow static bodies to participate in other islands.
+		for (int32 i = range->bodyStart; i < bodyCount; ++i)
 		{
-			// Allow static bodies to participate in other islands.
-			b2Body* b = island.m_bodies[i];
+			b2Body* b = islandBodies[i];
 			if (b->GetType() == b2_staticBody)
 			{
 				b->m_flags &= ~b2Body::e_islandFlag;
@@ -547,6 +768,80 @@ void b2World::Solve(const b2TimeStep& step)
 
 	m_stackAllocator.Free(stack);
 
+	b2ContactListener* listener = m_contactManager.m_contactListener;
+	if (m_taskExecutor == NULL || islandCount < 2)
+	{
+		b2Island island(maxBodyCount, maxContactCount, maxJointCount, &m_stackAllocator, listener);
+		for (int32 i = 0; i < islandCount; ++i)
+		{
+			const b2IslandRange& range = ranges[i];
+			island.Clear();
+			for (int32 j = 0; j < range.bodyCount; ++j)
+			{
+				island.Add(islandBodies[range.bodyStart + j]);
+			}
+			for (int32 j = 0; j < range.contactCount; ++j)
+			{
+				island.Add(islandContacts[range.contactStart + j]);
+			}
+			for (int32 j = 0; j < range.jointCount; ++j)
+			{
+				island.Add(islandJoints[range.jointStart + j]);
+			}
+
+			b2Profile profile;
+			island.Solve(&profile, step, m_gravity, m_allowSleep);
+			m_profile.solveInit += profile.solveInit;
+			m_profile.solveVelocity += profile.solveVelocity;
+			m_profile.solvePosition += profile.solvePosition;
+		}
+	}
+	else
+	{
+		b2ContactImpulse* impulses = (b2ContactImpulse*)m_stackAllocator.Allocate(contactCount * sizeof(b2ContactImpulse));
+		b2Profile* profiles = (b2Profile*)m_stackAllocator.Allocate(islandCount * sizeof(b2Profile));
+
+		b2IslandSolveTask task;
+		task.ranges = ranges;
+		task.bodies = islandBodies;
+		task.contacts = islandContacts;
+		task.joints = islandJoints;
+		task.impulses = impulses;
+		task.profiles = profiles;
+		task.mainAllocator = &m_stackAllocator;
+		task.workerAllocators = m_workerAllocators;
+		task.listener = listener;
+		task.step = &step;
+		task.gravity = m_gravity;
+		task.allowSleep = m_allowSleep;
+		m_taskExecutor->ParallelFor(&task, islandCount);
+
+		// These sum the time spent on all threads.
+		for (int32 i = 0; i < islandCount; ++i)
+		{
+			m_profile.solveInit += profiles[i].solveInit;
+			m_profile.solveVelocity += profiles[i].solveVelocity;
+			m_profile.solvePosition += profiles[i].solvePosition;
+		}
+
+		// Report in the order the serial solver would.
+		if (listener)
+		{
+			for (int32 i = 0; i < contactCount; ++i)
+			{
+				listener->PostSolve(islandContacts[i], impulses + i);
+			}
+		}
+
+		m_stackAllocator.Free(profiles);
+		m_stackAllocator.Free(impulses);
+	}
+
+	m_stackAllocator.Free(ranges);
+	m_stackAllocator.Free(islandJoints);
+	m_stackAllocator.Free(islandContacts);
+	m_stackAllocator.Free(islandBodies);
+
 	{
 		b2Timer timer;
 		// Synchronize fixtures, check for out of range bodies.
@@ -860,7 +1155,8 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.positionIterations = 20;
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.warmStarting = false;
-		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
+		subStep.wideSolver = false;
+		island.SolveTOI(subStep, island.GetIndex(bA), island.GetIndex(bB));
 
 		// Reset island flags and synchronize broad-phase proxies.
 		for (int32 i = 0; i < island.m_bodyCount; ++i)
@@ -896,8 +1192,16 @@ void b2World::SolveTOI(const b2TimeStep& step)
 
 void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIterations)
 {
+	b2Assert((m_flags & e_staticBatch) == 0);
+
 	b2Timer stepTimer;
 
+	m_stackAllocator.ResetStats();
+	for (int32 i = 0; i < m_workerAllocatorCount; ++i)
+	{
+		m_workerAllocators[i]->ResetStats();
+	}
+
 	// If new fixtures were added, we need to find the new contacts.
 	if (m_flags & e_newFixture)
 	{
@@ -923,6 +1227,7 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.wideSolver = m_wideSolver;
 	
 	// Update contacts. This is where some contacts are destroyed.
 	{
@@ -959,6 +1264,14 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 
 	m_flags &= ~e_locked;
 
+	m_profile.stackPeak = m_stackAllocator.GetMaxAllocation();
+	m_profile.stackGrowCount = m_stackAllocator.GetGrowCount();
+	for (int32 i = 0; i < m_workerAllocatorCount; ++i)
+	{
+		m_profile.stackPeak = b2Max(m_profile.stackPeak, m_workerAllocators[i]->GetMaxAllocation());
+		m_profile.stackGrowCount += m_workerAllocators[i]->GetGrowCount();
+	}
+
 	m_profile.step = stepTimer.GetMilliseconds();
 }
 
@@ -1028,6 +1341,201 @@ void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b
 	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
 }
 
+// Batched queries are split into blocks of this many for the task executor.
+const int32 b2_queryBatchBlockSize = 64;
+
+struct b2WorldQueryBatchWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		if (proxy->fixture->GetFilterData().categoryBits & maskBits)
+		{
+			b2QueryBatchResult::Add(buffer, proxy->fixture);
+		}
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	b2QueryBatchResult::Buffer* buffer;
+	uint16 maskBits;
+};
+
+class b2QueryBatchTask : public b2Task
+{
+public:
+	void Execute(int32 index, int32 threadIndex)
+	{
+		b2WorldQueryBatchWrapper wrapper;
+		wrapper.broadPhase = broadPhase;
+		wrapper.buffer = result->m_threadBuffers + threadIndex;
+		wrapper.maskBits = maskBits;
+
+		result->m_blockThreads[index] = threadIndex;
+		result->m_blockStarts[index] = wrapper.buffer->count;
+
+		// Store the count of each query for now; the gather turns these
+		// into offsets.
+		int32 begin = index * b2_queryBatchBlockSize;
+		int32 end = b2Min(begin + b2_queryBatchBlockSize, count);
+		for (int32 i = begin; i < end; ++i)
+		{
+			int32 start = wrapper.buffer->count;
+			broadPhase->Query(&wrapper, aabbs[i]);
+			result->m_begins[i + 1] = wrapper.buffer->count - start;
+		}
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2AABB* aabbs;
+	int32 count;
+	uint16 maskBits;
+	b2QueryBatchResult* result;
+};
+
+void b2World::QueryAABBBatch(const b2AABB* aabbs, int32 count, b2QueryBatchResult* result, uint16 maskBits) const
+{
+	const b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	int32 blockCount = (count + b2_queryBatchBlockSize - 1) / b2_queryBatchBlockSize;
+
+	if (m_taskExecutor == NULL || blockCount < 2)
+	{
+		result->Reset(count, 0, 0);
+
+		b2WorldQueryBatchWrapper wrapper;
+		wrapper.broadPhase = broadPhase;
+		wrapper.buffer = &result->m_fixtures;
+		wrapper.maskBits = maskBits;
+		for (int32 i = 0; i < count; ++i)
+		{
+			broadPhase->Query(&wrapper, aabbs[i]);
+			result->m_begins[i + 1] = result->m_fixtures.count;
+		}
+		return;
+	}
+
+	result->Reset(count, blockCount, m_taskExecutor->GetThreadCount());
+
+	b2QueryBatchTask task;
+	task.broadPhase = broadPhase;
+	task.aabbs = aabbs;
+	task.count = count;
+	task.maskBits = maskBits;
+	task.result = result;
+	m_taskExecutor->ParallelFor(&task, blockCount);
+
+	int32* begins = result->m_begins;
+	for (int32 i = 0; i < count; ++i)
+	{
+		begins[i + 1] += begins[i];
+	}
+
+	b2QueryBatchResult::Reserve(&result->m_fixtures, begins[count]);
+	result->m_fixtures.count = begins[count];
+
+	// Gather the blocks in query order.
+	for (int32 i = 0; i < blockCount; ++i)
+	{
+		int32 begin = begins[i * b2_queryBatchBlockSize];
+		int32 end = begins[b2Min((i + 1) * b2_queryBatchBlockSize, count)];
+		const b2QueryBatchResult::Buffer* buffer = result->m_threadBuffers + result->m_blockThreads[i];
+		memcpy(result->m_fixtures.fixtures + begin, buffer->fixtures + result->m_blockStarts[i],
+			   (end - begin) * sizeof(b2Fixture*));
+	}
+}
+
+struct b2WorldRayCastBatchWrapper
+{
+	float32 RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		if ((fixture->GetFilterData().categoryBits & maskBits) == 0)
+		{
+			return input.maxFraction;
+		}
+
+		b2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, proxy->childIndex);
+		if (hit == false)
+		{
+			return input.maxFraction;
+		}
+
+		// The shapes only report hits closer than maxFraction, so clipping
+		// the ray here leaves the closest hit once the cast ends.
+		float32 fraction = output.fraction;
+		closest->fixture = fixture;
+		closest->point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+		closest->normal = output.normal;
+		closest->fraction = fraction;
+		return fraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	b2RayCastHit* closest;
+	uint16 maskBits;
+};
+
+class b2RayCastBatchTask : public b2Task
+{
+public:
+	void Execute(int32 index, int32 threadIndex)
+	{
+		B2_NOT_USED(threadIndex);
+
+		int32 begin = index * b2_queryBatchBlockSize;
+		int32 end = b2Min(begin + b2_queryBatchBlockSize, count);
+		RayCast(broadPhase, inputs + begin, end - begin, hits + begin, maskBits);
+	}
+
+	static void RayCast(const b2BroadPhase* broadPhase, const b2RayCastInput* inputs, int32 count,
+						b2RayCastHit* hits, uint16 maskBits)
+	{
+		b2WorldRayCastBatchWrapper wrapper;
+		wrapper.broadPhase = broadPhase;
+		wrapper.maskBits = maskBits;
+		for (int32 i = 0; i < count; ++i)
+		{
+			const b2RayCastInput& input = inputs[i];
+			b2RayCastHit* hit = hits + i;
+			hit->fixture = NULL;
+			hit->point = (1.0f - input.maxFraction) * input.p1 + input.maxFraction * input.p2;
+			hit->normal.SetZero();
+			hit->fraction = input.maxFraction;
+
+			wrapper.closest = hit;
+			broadPhase->RayCast(&wrapper, input);
+		}
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2RayCastInput* inputs;
+	int32 count;
+	b2RayCastHit* hits;
+	uint16 maskBits;
+};
+
+void b2World::RayCastBatch(const b2RayCastInput* inputs, int32 count, b2RayCastHit* hits, uint16 maskBits) const
+{
+	const b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	int32 blockCount = (count + b2_queryBatchBlockSize - 1) / b2_queryBatchBlockSize;
+
+	if (m_taskExecutor == NULL || blockCount < 2)
+	{
+		b2RayCastBatchTask::RayCast(broadPhase, inputs, count, hits, maskBits);
+		return;
+	}
+
+	b2RayCastBatchTask task;
+	task.broadPhase = broadPhase;
+	task.inputs = inputs;
+	task.count = count;
+	task.hits = hits;
+	task.maskBits = maskBits;
+	m_taskExecutor->ParallelFor(&task, blockCount);
+}
+
 void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
 {
 	switch (fixture->GetType())
@@ -1241,6 +1749,11 @@ int32 b2World::GetProxyCount() const
 	return m_contactManager.m_broadPhase.GetProxyCount();
 }
 
+b2BroadPhaseType b2World::GetBroadPhaseType() const
+{
+	return m_contactManager.m_broadPhase.GetType();
+}
+
 int32 b2World::GetTreeHeight() const
 {
 	return m_contactManager.m_broadPhase.GetTreeHeight();
@@ -1256,6 +1769,11 @@ float32 b2World::GetTreeQuality() const
 	return m_contactManager.m_broadPhase.GetTreeQuality();
 }
 
+void b2World::GetBlockAllocatorStats(b2BlockAllocatorStats* stats) const
+{
+	m_blockAllocator.GetStats(stats);
+}
+
 void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	b2Assert((m_flags & e_locked) == 0);
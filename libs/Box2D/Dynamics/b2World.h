@@ -34,6 +34,7 @@ class b2Body;
 class b2Draw;
 class b2Fixture;
 class b2Joint;
+class b2TaskExecutor;
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
@@ -43,7 +44,9 @@ class b2World
 public:
 	/// Construct a world object.
 	/// @param gravity the world gravity vector.
-	b2World(const b2Vec2& gravity);
+	/// @param broadPhaseType where the broad-phase keeps the proxies of bodies
+	/// that are not static. See b2BroadPhaseType.
+	b2World(const b2Vec2& gravity, b2BroadPhaseType broadPhaseType = b2_treeBroadPhase);
 
 	/// Destruct the world. All physics entities are destroyed and all heap memory is released.
 	~b2World();
@@ -66,6 +69,17 @@ public:
 	/// by you and must remain in scope.
 	void SetDebugDraw(b2Draw* debugDraw);
 
+	/// Update contacts and solve separate islands in parallel using the given
+	/// executor, or serially if executor is NULL (the default). The executor
+	/// is owned by you and must remain in scope. Contact listener calls are
+	/// still made from the thread calling Step, in the same order and with
+	/// the same results as the serial code.
+	/// @warning This function is locked during callbacks.
+	void SetTaskExecutor(b2TaskExecutor* executor);
+
+	/// Get the executor set with SetTaskExecutor.
+	b2TaskExecutor* GetTaskExecutor() const;
+
 	/// Create a rigid body given a definition. No reference to the definition
 	/// is retained.
 	/// @warning This function is locked during callbacks.
@@ -86,6 +100,18 @@ public:
 	/// @warning This function is locked during callbacks.
 	void DestroyJoint(b2Joint* joint);
 
+	/// Start creating static geometry in bulk, such as when a level loads.
+	/// Until EndStaticBatch, fixtures created on static bodies get no
+	/// broad-phase proxies. Other bodies are not affected.
+	/// @warning This function is locked during callbacks.
+	void BeginStaticBatch();
+
+	/// Create the broad-phase proxies of the fixtures added since
+	/// BeginStaticBatch. The proxies are built into one subtree in O(n log n)
+	/// instead of being inserted one by one. Call this before the next Step.
+	/// @warning This function is locked during callbacks.
+	void EndStaticBatch();
+
 	/// Take a time step. This performs collision detection, integration,
 	/// and constraint solution.
 	/// @param timeStep the amount of time to simulate, this should not vary.
@@ -121,6 +147,27 @@ public:
 	/// @param point2 the ray ending point
 	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
 
+	/// Query the world with many AABBs at once. This skips the per fixture
+	/// callback and spreads large batches over the task executor, so it is
+	/// much cheaper than calling QueryAABB in a loop. Call it from the thread
+	/// that calls Step, and not during Step.
+	/// @param aabbs the query boxes.
+	/// @param count the number of query boxes.
+	/// @param result receives the fixtures that potentially overlap each box.
+	/// @param maskBits only fixtures with a category bit in this mask are reported.
+	void QueryAABBBatch(const b2AABB* aabbs, int32 count, b2QueryBatchResult* result,
+						uint16 maskBits = 0xFFFF) const;
+
+	/// Ray-cast the world with many rays at once and find the closest hit of
+	/// each. Like QueryAABBBatch, large batches are spread over the task executor.
+	/// The ray-cast ignores shapes that contain the starting point.
+	/// @param inputs the rays. A ray only reports hits up to its maxFraction.
+	/// @param count the number of rays.
+	/// @param hits receives the closest hit of each ray, count entries.
+	/// @param maskBits only fixtures with a category bit in this mask are hit.
+	void RayCastBatch(const b2RayCastInput* inputs, int32 count, b2RayCastHit* hits,
+					  uint16 maskBits = 0xFFFF) const;
+
 	/// Get the world body list. With the returned body, use b2Body::GetNext to get
 	/// the next body in the world list. A NULL body indicates the end of the list.
 	/// @return the head of the world body list.
@@ -157,9 +204,19 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Enable/disable the SIMD contact solver. It solves several contacts
+	/// at once, grouped so that no two in a group share a dynamic body. The
+	/// different solve order gives slightly different results from the
+	/// default scalar solver, which remains the reference.
+	void SetWideSolver(bool flag) { m_wideSolver = flag; }
+	bool GetWideSolver() const { return m_wideSolver; }
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
+	/// Get the broad-phase type the world was constructed with.
+	b2BroadPhaseType GetBroadPhaseType() const;
+
 	/// Get the number of bodies.
 	int32 GetBodyCount() const;
 
@@ -179,6 +236,10 @@ public:
 	/// The minimum is 1.
 	float32 GetTreeQuality() const;
 
+	/// Get the usage counters of the allocator that holds the bodies,
+	/// fixtures, shapes, joints and contacts.
+	void GetBlockAllocatorStats(b2BlockAllocatorStats* stats) const;
+
 	/// Change the global gravity vector.
 	void SetGravity(const b2Vec2& gravity);
 	
@@ -216,7 +277,8 @@ private:
 	{
 		e_newFixture	= 0x0001,
 		e_locked		= 0x0002,
-		e_clearForces	= 0x0004
+		e_clearForces	= 0x0004,
+		e_staticBatch	= 0x0008
 	};
 
 	friend class b2Body;
@@ -227,14 +289,25 @@ private:
 	void Solve(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
 
+	void DestroyWorkerAllocators();
+
 	void DrawJoint(b2Joint* joint);
 	void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
 
 	b2BlockAllocator m_blockAllocator;
 	b2StackAllocator m_stackAllocator;
 
+	// Used for parallel island solving. Thread 0 of the executor uses
+	// m_stackAllocator; m_workerAllocators[i - 1] belongs to thread i.
+	b2TaskExecutor* m_taskExecutor;
+	b2StackAllocator** m_workerAllocators;
+	int32 m_workerAllocatorCount;
+
 	int32 m_flags;
 
+	// Fixtures created without proxies since BeginStaticBatch.
+	int32 m_batchedFixtureCount;
+
 	b2ContactManager m_contactManager;
 
 	b2Body* m_bodyList;
@@ -257,6 +330,7 @@ private:
 	bool m_warmStarting;
 	bool m_continuousPhysics;
 	bool m_subStepping;
+	bool m_wideSolver;
 
 	bool m_stepComplete;
 
@@ -346,6 +420,11 @@ inline const b2ContactManager& b2World::GetContactManager() const
 	return m_contactManager;
 }
 
+inline b2TaskExecutor* b2World::GetTaskExecutor() const
+{
+	return m_taskExecutor;
+}
+
 inline const b2Profile& b2World::GetProfile() const
 {
 	return m_profile;
@@ -18,6 +18,7 @@
 
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/b2Fixture.h>
+#include <string.h>
 
 // Return true if contact calculations should be performed between these two shapes.
 // If you implement your own collision filter you may want to build from this implementation.
@@ -34,3 +35,113 @@ bool b2ContactFilter::ShouldCollide(b2Fixture* fixtureA, b2Fixture* fixtureB)
 	bool collide = (filterA.maskBits & filterB.categoryBits) != 0 && (filterA.categoryBits & filterB.maskBits) != 0;
 	return collide;
 }
+
+b2QueryBatchResult::b2QueryBatchResult()
+{
+	m_fixtures.fixtures = NULL;
+	m_fixtures.count = 0;
+	m_fixtures.capacity = 0;
+
+	m_queryCount = 0;
+	m_queryCapacity = 0;
+	m_begins = (int32*)b2Alloc(sizeof(int32));
+	m_begins[0] = 0;
+
+	m_threadBuffers = NULL;
+	m_threadCount = 0;
+	m_blockThreads = NULL;
+	m_blockStarts = NULL;
+	m_blockCapacity = 0;
+}
+
+b2QueryBatchResult::~b2QueryBatchResult()
+{
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		b2Free(m_threadBuffers[i].fixtures);
+	}
+	b2Free(m_threadBuffers);
+	b2Free(m_blockThreads);
+	b2Free(m_blockStarts);
+	b2Free(m_begins);
+	b2Free(m_fixtures.fixtures);
+}
+
+void b2QueryBatchResult::Reserve(Buffer* buffer, int32 capacity)
+{
+	if (capacity <= buffer->capacity)
+	{
+		return;
+	}
+
+	int32 newCapacity = b2Max(2 * buffer->capacity, 64);
+	while (newCapacity < capacity)
+	{
+		newCapacity *= 2;
+	}
+
+	b2Fixture** old = buffer->fixtures;
+	buffer->fixtures = (b2Fixture**)b2Alloc(newCapacity * sizeof(b2Fixture*));
+	if (old)
+	{
+		memcpy(buffer->fixtures, old, buffer->count * sizeof(b2Fixture*));
+		b2Free(old);
+	}
+	buffer->capacity = newCapacity;
+}
+
+void b2QueryBatchResult::Add(Buffer* buffer, b2Fixture* fixture)
+{
+	if (buffer->count == buffer->capacity)
+	{
+		Reserve(buffer, buffer->count + 1);
+	}
+
+	buffer->fixtures[buffer->count] = fixture;
+	++buffer->count;
+}
+
+void b2QueryBatchResult::Reset(int32 queryCount, int32 blockCount, int32 threadCount)
+{
+	if (queryCount > m_queryCapacity)
+	{
+		b2Free(m_begins);
+		m_queryCapacity = queryCount;
+		m_begins = (int32*)b2Alloc((m_queryCapacity + 1) * sizeof(int32));
+	}
+	m_queryCount = queryCount;
+	m_begins[0] = 0;
+	m_fixtures.count = 0;
+
+	if (blockCount > m_blockCapacity)
+	{
+		b2Free(m_blockThreads);
+		b2Free(m_blockStarts);
+		m_blockCapacity = blockCount;
+		m_blockThreads = (int32*)b2Alloc(m_blockCapacity * sizeof(int32));
+		m_blockStarts = (int32*)b2Alloc(m_blockCapacity * sizeof(int32));
+	}
+
+	if (threadCount > m_threadCount)
+	{
+		Buffer* old = m_threadBuffers;
+		m_threadBuffers = (Buffer*)b2Alloc(threadCount * sizeof(Buffer));
+		if (old)
+		{
+			memcpy(m_threadBuffers, old, m_threadCount * sizeof(Buffer));
+			b2Free(old);
+		}
+
+		for (int32 i = m_threadCount; i < threadCount; ++i)
+		{
+			m_threadBuffers[i].fixtures = NULL;
+			m_threadBuffers[i].capacity = 0;
+		}
+		m_threadCount = threadCount;
+	}
+
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		m_threadBuffers[i].count = 0;
+	}
+}
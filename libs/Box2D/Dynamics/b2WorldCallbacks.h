@@ -19,9 +19,8 @@
 #ifndef B2_WORLD_CALLBACKS_H
 #define B2_WORLD_CALLBACKS_H
 
-#include <Box2D/Common/b2Settings.h>
+#include <Box2D/Common/b2Math.h>
 
-struct b2Vec2;
 struct b2Transform;
 class b2Fixture;
 class b2Body;
@@ -152,4 +151,81 @@ public:
 									const b2Vec2& normal, float32 fraction) = 0;
 };
 
+/// The closest hit of one ray in a batch.
+/// See b2World::RayCastBatch
+struct b2RayCastHit
+{
+	b2Fixture* fixture;	///< NULL if the ray hit nothing
+	b2Vec2 point;
+	b2Vec2 normal;
+	float32 fraction;
+};
+
+/// The fixtures found by a batch of AABB queries, stored back to back in one
+/// array. Reuse the same object for every batch so its buffers only grow.
+/// See b2World::QueryAABBBatch
+class b2QueryBatchResult
+{
+public:
+	b2QueryBatchResult();
+	~b2QueryBatchResult();
+
+	/// The number of queries in the last batch.
+	int32 GetQueryCount() const;
+
+	/// The fixtures that potentially overlap the AABB of query i.
+	b2Fixture* const* GetFixtures(int32 i) const;
+	int32 GetFixtureCount(int32 i) const;
+
+private:
+
+	friend class b2World;
+	friend class b2QueryBatchTask;
+	friend struct b2WorldQueryBatchWrapper;
+
+	struct Buffer
+	{
+		b2Fixture** fixtures;
+		int32 count;
+		int32 capacity;
+	};
+
+	static void Reserve(Buffer* buffer, int32 capacity);
+	static void Add(Buffer* buffer, b2Fixture* fixture);
+
+	void Reset(int32 queryCount, int32 blockCount, int32 threadCount);
+
+	Buffer m_fixtures;
+
+	// Query i owns m_fixtures.fixtures[m_begins[i]] up to m_begins[i + 1].
+	int32* m_begins;
+	int32 m_queryCount;
+	int32 m_queryCapacity;
+
+	// A parallel batch writes each block of queries to the buffer of the
+	// thread that ran it, then copies the blocks into m_fixtures in order.
+	Buffer* m_threadBuffers;
+	int32 m_threadCount;
+	int32* m_blockThreads;
+	int32* m_blockStarts;
+	int32 m_blockCapacity;
+};
+
+inline int32 b2QueryBatchResult::GetQueryCount() const
+{
+	return m_queryCount;
+}
+
+inline b2Fixture* const* b2QueryBatchResult::GetFixtures(int32 i) const
+{
+	b2Assert(0 <= i && i < m_queryCount);
+	return m_fixtures.fixtures + m_begins[i];
+}
+
+inline int32 b2QueryBatchResult::GetFixtureCount(int32 i) const
+{
+	b2Assert(0 <= i && i < m_queryCount);
+	return m_begins[i + 1] - m_begins[i];
+}
+
 #endif
@@ -15,76 +15,24 @@ and may not be redistributed without written permission.*/
 #include "render.h"
 #include "assets.h"
 #include "common.h"
+#include "world.h"
+#include "animation.h"
+#include "components.h"
+#include "ecs.h"
+#include "jobs.h"
+#include "timestep.h"
 #include <stack>
 #include <utility>
 #include <functional>
 #include <cctype>
 #include <set>
 #include <iostream>
-#include "json.h"
 #include <fstream>
 #include "Box2D/Box2D.h"
 
-using json = nlohmann::json;
-
-#define SPRITE_COUNT 500
-
-const int targetFrameDuration = 1000 / 200;  // 200 frames per sec
-
-SDL_Rect rects[SPRITE_COUNT];
-
 bool debugDraw;
 
 
-class Vector {
- private:
-
- public:
- 	float x;
- 	float y;
-
-  Vector() : Vector(0.0f, 0.0f) {}
-
-  Vector (float x, float y) {
-  	this->x = x;
-  	this->y = y;
-  }
-
-  float getX() {
-  	return x;
-  }
-
-  float getY() {
-  	return y;
-  }
-};
-
-class Transform {
- private:
-  Vector position;
-  float rotation;
-  float scale;
-
- public:
-  Transform() {
-    position = Vector();
-    rotation = 0.0f;
-    scale = 1.0f;
-  }
-
-  Vector getPosition() const { return position; }
-
-  void setPosition(Vector position) { this->position = position; }
-
-  float getRotation() const { return rotation; }
-
-  void setRotation(float rotation) { this->rotation = rotation; }
-
-  float getScale() const { return scale; }
-
-  void setScale(float scale) { this->scale = scale; }
-};
-
 
 bool initSystem() {
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -95,116 +43,6 @@ bool initSystem() {
   return initRenderingSystem();
 }
 
-class AnimationFrame {
-private:
-	int duration;
-	SDL_Rect frame;
-
-public:
-	AnimationFrame(int duration, SDL_Rect frame) {
-		this->duration = duration;
-		this->frame = frame;
-	}
-
-	const SDL_Rect& getFrame() const {
-		return frame;
-	}
-
-	int getDuration() const {
-		return duration;
-	}
-};
-
-class AnimationData {
-private:
-	unique_ptr<vector<unique_ptr<const AnimationFrame>>> frames;
-	string texturePath;
-
-public:
-	AnimationData(string texturePath,  unique_ptr<vector<unique_ptr<const AnimationFrame>>> frames) {
-		this->texturePath = texturePath;
-		this->frames = move(frames);
-	}
-
-	const vector<unique_ptr<const AnimationFrame>>& getFrames() const {
-		return *frames;
-	}
-
-	const string getTexturePath() const {
-		return texturePath;
-	}
-};
-
-bool loadAnimationData(string path, unique_ptr<AnimationData>* animationData) {
-	LOG_STREAM() << "Loading AnimationData for: " << path << endl;
-	std::ifstream i(path);
-	json animationJson;
-	i >> animationJson;
-
-	auto framesItr = animationJson.find("frames");
-	if (framesItr == animationJson.end()) {
-		LOG_STREAM() << "Error! Can't find 'frames' in animation json." << endl;
-		return false;
-	}
-
-	auto frames = framesItr.value();
-	if (!frames.is_array()) {
-		LOG_STREAM() << "Error! Expected 'frames' to be an array." << endl;
-		return false;
-	}
-
-	unique_ptr<vector<unique_ptr<const AnimationFrame>>> animationFrames = 
-		unique_ptr<vector<unique_ptr<const AnimationFrame>>>(new vector<unique_ptr<const AnimationFrame>>());
-
-	for (int i = 0; i < frames.size(); i++) {
-		json frame = frames[i];
-
-		// TODO make robust to failure
-		int duration =  frame.at("duration");
-
-		json frameData = frame.at("frame");
-
-		SDL_Rect rect;
-
-		rect.x = frameData.at("x");
-		rect.y = frameData.at("y");
-		rect.w = frameData.at("w");
-		rect.h = frameData.at("h");
-
-
-		animationFrames->push_back(unique_ptr<AnimationFrame>(new AnimationFrame(duration, rect)));
-	}
-
- 	string texturePath = animationJson.at("meta").at("image");
-	*animationData = unique_ptr<AnimationData> (new AnimationData(texturePath, move(animationFrames)));
-
-	return true;
-}
-
-void createTile(b2World& world, TileMap& tileMap, int x, int y, shared_ptr<TileInstance> tileInstance) {
-	tileMap.set(x, y, tileInstance);
-
-	int tileLength = tileMap.getTileLength();
-
-	b2BodyDef groundBodyDef;
-	LOG("New Tile at X(%f), Y(%f)\n", x * tileLength * PIXELS_TO_B2_UNITS, -y * tileLength * PIXELS_TO_B2_UNITS);
-	groundBodyDef.position.Set(x * tileLength * PIXELS_TO_B2_UNITS, -y * tileLength * PIXELS_TO_B2_UNITS);
-
-	// Call the body factory which allocates memory for the ground body
-	// from a pool and creates the ground box shape (also from a pool).
-	// The body is also added to the world.
-	b2Body* groundBody = world.CreateBody(&groundBodyDef);
-
-	// Define the ground box shape.
-	b2PolygonShape groundBox;
-
-	// The extents are the half-widths of the box.
-	groundBox.SetAsBox(tileLength * PIXELS_TO_B2_UNITS/2.0f, tileLength * PIXELS_TO_B2_UNITS/2.0f);
-
-	// Add the ground fixture to the ground body.
-	groundBody->CreateFixture(&groundBox, 0.0f);
-}
-
 void loadImage(const string& imgPath) {
 	if (!initSystem()) {
 	  LOG("Failed to initialize system! Exiting...\n");
@@ -234,11 +72,10 @@ void loadImage(const string& imgPath) {
 	  return;
 	}
 
-	// Current displayed texture
-	shared_ptr<Texture> texture = shared_ptr<Texture>(NULL);
-
-	if (!assetManager->getTexture(imgPath, &texture)) {
-	  LOG("Failed to load texture! Exiting...\n");
+	// Current displayed texture. Shows a placeholder until it has loaded.
+	shared_ptr<TextureHandle> texture = assetManager->getTextureAsync(imgPath);
+	if (texture.get() == NULL) {
+	  LOG("Failed to start loading texture\n");
 	  return;
 	}
 
@@ -254,6 +91,7 @@ void loadImage(const string& imgPath) {
 
 	char fpsBuf[20];
 	string fpsText = "";
+	TextRun fpsRun;
 	int previousFrameStart = SDL_GetTicks();
 
 	// While application is running
@@ -269,12 +107,19 @@ void loadImage(const string& imgPath) {
 	    }
 	  }
 
+    assetManager->update();
+    if (texture->isFailed()) {
+      LOG("Failed to load image: %s\n", imgPath.c_str());
+      break;
+    }
+
     // Clear screen
     renderer->clear();
 
-    renderer->render(*texture, NULL, NULL);
+    renderer->render(*texture->getTexture(), NULL, NULL);
 
-    font->render(*renderer, fpsText, 10, 10);
+    fpsRun.setText(*font, fpsText);
+    font->render(*renderer, fpsRun, 10, 10);
 
     renderer->present();
 
@@ -313,10 +158,11 @@ void runGame() {
 	}
 
 	// Define the gravity vector.
-	b2Vec2 gravity(0.0f, -1.0f);
+	b2Vec2 gravity(0.0f, WORLD_GRAVITY);
 
 	// Construct a world object, which will hold and simulate the rigid bodies.
 	b2World world(gravity);
+	world.SetWideSolver(true);
 
   shared_ptr<Renderer> renderer = shared_ptr<Renderer>(NULL);
 
@@ -330,6 +176,12 @@ void runGame() {
 
   unique_ptr<AssetManager> assetManager =
       unique_ptr<AssetManager>(new AssetManager(renderer));
+  assetManager->setAtlasEnabled(true);
+
+  // Cooked assets from the CookAssets target, if they have been built.
+  if (!assetManager->loadBundle("assets.bundle", "../assets/")) {
+    LOG("No asset bundle, loading loose assets\n");
+  }
 
   // Current displayed texture
   shared_ptr<Texture> texture = shared_ptr<Texture>(NULL);
@@ -341,13 +193,6 @@ void runGame() {
     return;
   }
 
-  for (int i = 0; i < SPRITE_COUNT; i++) {
-    rects[i].x = rand() % SCREEN_WIDTH;
-    rects[i].y = rand() % SCREEN_HEIGHT + 50;
-    rects[i].w = 40;
-    rects[i].h = 40;
-  }
-
   int failure;
   shared_ptr<Font> font;
   if (!assetManager->getFont("../assets/arial_regular_10", &font)) {
@@ -356,11 +201,29 @@ void runGame() {
   }
 
   unique_ptr<AnimationData> animationData;
-	if(!loadAnimationData("../assets/Walk.json", &animationData)) {
+	if(!assetManager->getAnimationData("../assets/Walk.json", &animationData)) {
 		LOG("Could not load animation!\n");
 		return;
 	}
 
+  // The exported texture path is absolute on the machine that exported it,
+  // so only its file name is used.
+  string walkTexturePath = animationData->getTexturePath();
+  walkTexturePath = "../assets/" + walkTexturePath.substr(walkTexturePath.find_last_of('/') + 1);
+
+  shared_ptr<Texture> walkTexture;
+  if (!assetManager->getTexture(walkTexturePath, &walkTexture)) {
+    LOG("Failed to load animation texture!\n");
+    return;
+  }
+
+  AnimationSystem animations;
+  AnimationClipId walkClip = animations.addClip(*animationData);
+  if (walkClip < 0) {
+    LOG("Animation has no frames!\n");
+    return;
+  }
+
   shared_ptr<TilePalette> tilePalette;
   if (!assetManager->getTilePalette("test-path", tilePalette)) {
     LOG("Error loading tile palette!\n");
@@ -375,55 +238,30 @@ void runGame() {
   }
 
   TileMap tileMap = TileMap(20, 20, 32);
+  tileMap.setChunkBaking(true);
 
-  createTile(world, tileMap, 4, 4, tileInstance);
-  createTile(world, tileMap, 4, 5, tileInstance);
-  createTile(world, tileMap, 4, 6, tileInstance);
-  createTile(world, tileMap, 5, 6, tileInstance);
-  createTile(world, tileMap, 6, 6, tileInstance);
-  createTile(world, tileMap, 7, 6, tileInstance);
-
-  createTile(world, tileMap, 9, 6, tileInstance);
-  createTile(world, tileMap, 10, 6, tileInstance);
-  createTile(world, tileMap, 11, 6, tileInstance);
-  createTile(world, tileMap, 12, 6, tileInstance);
-  createTile(world, tileMap, 12, 5, tileInstance);
-  createTile(world, tileMap, 12, 4, tileInstance);
-  createTile(world, tileMap, 13, 4, tileInstance);
-  createTile(world, tileMap, 14, 4, tileInstance);
-
-  SDL_Rect playerDestination{0, 0, texture->getWidth(), texture->getHeight()};
-  float playerSpeed = 200.0f / 10000;  // per ms
-
-  // Define the dynamic body. We set its position and call the body factory.
-	b2BodyDef bodyDef;
-	bodyDef.type = b2_dynamicBody;
-	bodyDef.position.Set(200.0f * PIXELS_TO_B2_UNITS, -150.0f * PIXELS_TO_B2_UNITS);
-	bodyDef.gravityScale = 1.0f;
-	b2Body* playerBody = world.CreateBody(&bodyDef);
-
-	// Define another box shape for our dynamic body.
-	b2PolygonShape dynamicBox;
-	LOG("Texture Width(%d) Height(%d)\n", texture->getWidth(), texture->getHeight());
-	dynamicBox.SetAsBox(texture->getWidth() * PIXELS_TO_B2_UNITS/2.0f, texture->getHeight() * PIXELS_TO_B2_UNITS/2.0f);
-
-	// Define the dynamic body fixture.
-	b2FixtureDef fixtureDef;
-	fixtureDef.shape = &dynamicBox;
-
-	// Set the box density to be non-zero, so it will be dynamic.
-	fixtureDef.density = 20.0f;
+  createLevel(tileMap, tileInstance);
 
-	// Override the default friction.
-	fixtureDef.friction = 0.3f;
+  TileColliders tileColliders(world, tileMap);
+  tileColliders.update();
 
-	// Add the shape to the body.
-	playerBody->CreateFixture(&fixtureDef);
-
-
-	float32 timeStep = 1.0f / 60.0f;
-	int32 velocityIterations = 6;
-	int32 positionIterations = 2;
+	LOG("Texture Width(%d) Height(%d)\n", texture->getWidth(), texture->getHeight());
+	b2Body* playerBody = createPlayerBody(world, texture->getWidth(), texture->getHeight());
+
+  EntityManager entities;
+
+  Entity player = entities.create();
+  entities.add(player, Transform());
+  SpriteComponent playerSprite = { walkTexture.get(), { 0, 0, 0, 0 }, texture->getWidth(), texture->getHeight() };
+  entities.add(player, playerSprite);
+  BodyComponent playerBodyComponent = { playerBody, playerBody->GetPosition(), playerBody->GetPosition() };
+  entities.add(player, playerBodyComponent);
+  AnimationComponent playerAnimation = { animations.play(walkClip) };
+  if (playerAnimation.instance < 0) {
+    LOG("Could not play animation!\n");
+    return;
+  }
+  entities.add(player, playerAnimation);
 
   // Main loop flag
   bool quit = false;
@@ -437,13 +275,19 @@ void runGame() {
 
   char fpsBuf[20];
   string fpsText = "";
-  int previousFrameStart = SDL_GetTicks();
+  TextRun fpsRun;
+
+  FixedTimestep timestep(PHYSICS_TIME_STEP);
+  float stepMillis = PHYSICS_TIME_STEP * 1000.0f;
+
+  JobSystem jobs(JobSystem::getDefaultWorkerCount());
+  JobSystemTaskExecutor physicsExecutor(jobs);
+  world.SetTaskExecutor(&physicsExecutor);
 
   // While application is running
   while (!quit) {
     start = SDL_GetPerformanceCounter();
     int frameStart = SDL_GetTicks();
-    int dt = frameStart - previousFrameStart;
     // Handle events on queue
     while (SDL_PollEvent(&e) != 0) {
       // User requests quit
@@ -451,6 +295,11 @@ void runGame() {
         quit = true;
       }
 
+      // Render target contents are lost when the device is reset.
+      if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+        tileMap.invalidateBakedChunks();
+      }
+
       if (e.type == SDL_KEYUP && e.key.keysym.scancode == SDL_SCANCODE_F1) {
 	    	if (! debugDraw) {
 	    		debugDraw = true;
@@ -465,40 +314,50 @@ void runGame() {
 
     const Uint8* state = SDL_GetKeyboardState(NULL);
 
-    b2Vec2 velocity;
-    if (state[SDL_SCANCODE_UP]) {
-      velocity.y -= playerSpeed * dt;
-    }
+    PlayerInput input;
+    input.up = state[SDL_SCANCODE_UP];
+    input.down = state[SDL_SCANCODE_DOWN];
+    input.right = state[SDL_SCANCODE_RIGHT];
+    input.left = state[SDL_SCANCODE_LEFT];
 
-    if (state[SDL_SCANCODE_DOWN]) {
-      velocity.y += playerSpeed * dt;
-    }
+    int steps = timestep.advance();
+    for (int i = 0; i < steps; i++) {
+      storePreviousBodyPositions(entities);
 
-    if (state[SDL_SCANCODE_RIGHT]) {
-      velocity.x += playerSpeed * dt;
-    }
+      applyPlayerInput(playerBody, input, stepMillis);
+
+      // Animations do not depend on physics, so they advance on the workers
+      // while the world steps.
+      JobCounter animationJobs;
+      jobs.parallelFor(animations.getInstanceCount(), ANIMATION_JOB_SIZE, [&animations, stepMillis](int begin, int end) {
+        animations.update(stepMillis, begin, end);
+      }, &animationJobs);
 
-    if (state[SDL_SCANCODE_LEFT]) {
-      velocity.x -= playerSpeed * dt;
+      world.Step(PHYSICS_TIME_STEP, PHYSICS_VELOCITY_ITERATIONS, PHYSICS_POSITION_ITERATIONS);
+      jobs.wait(animationJobs);
+
+      storeCurrentBodyPositions(entities);
     }
 
-    b2Vec2 p = playerBody->GetWorldPoint(b2Vec2(0.0f, 0.0f));
-    playerBody->ApplyLinearImpulse(playerBody->GetWorldVector(velocity), p, true);
+    interpolateBodyTransforms(entities, timestep.getAlpha());
+    updateAnimatedSprites(entities, animations);
 
-    world.Step(timeStep, velocityIterations, positionIterations);
+    assetManager->update();
+    jobs.pumpMainThread();
 
-    playerDestination.x = playerBody->GetPosition().x * B2_UNITS_TO_PIXELS - 16;
-    playerDestination.y = -playerBody->GetPosition().y * B2_UNITS_TO_PIXELS - 16;
-    //LOG_STREAM() << "Player Destination: X(" << playerDestination.x << ") Y(" << playerDestination.y << ")" << endl;
+    // Text layout only reads the font, so it can run while the tiles draw.
+    JobCounter textJobs;
+    jobs.schedule([&fpsRun, &font, &fpsText] { fpsRun.setText(*font, fpsText); }, &textJobs);
 
     // Clear screen
     renderer->clear();
 
     tileMap.render(*renderer, 0, 0);
 
-    renderer->render(*texture, NULL, &playerDestination);
+    renderSprites(entities, *renderer);
 
-    font->render(*renderer, fpsText, 10, 10);
+    jobs.wait(textJobs);
+    font->render(*renderer, fpsRun, 10, 10);
 
     if (debugDraw) {
 	    world.DrawDebugData();
@@ -514,8 +373,6 @@ void runGame() {
       fpsText = fpsBuf;
       lastLoggedFPS = frameStart;
     }
-
-    previousFrameStart = frameStart;
   }
 
     // Destroy window
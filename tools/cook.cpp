@@ -0,0 +1,256 @@
+// Converts loose assets into a single bundle that AssetManager::loadBundle
+// can map at startup. PNGs are decoded to RGBA8888, font XML and Aseprite
+// animation JSON are parsed into fixed-size records.
+//
+// Usage: AssetCook <assetDir> <output> <file>...
+// File names are relative to assetDir and become the names in the bundle.
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+#include "fonts.h"
+#include "render.h"
+#include "assets.h"
+#include "animation.h"
+#include "bundle.h"
+#include "common.h"
+
+using namespace std;
+
+struct PendingEntry {
+  Uint32 type;
+  string name;
+  Uint32 dataOffset;
+  Uint32 dataSize;
+};
+
+struct PendingString {
+  Uint32 recordOffset;
+  string value;
+};
+
+class BundleWriter {
+ private:
+  vector<Uint8> data;
+  vector<PendingEntry> entries;
+  // Strings referenced from inside records, patched in when the string
+  // table is written.
+  vector<PendingString> strings;
+
+  void align() {
+    data.resize((data.size() + BUNDLE_ALIGNMENT - 1) / BUNDLE_ALIGNMENT * BUNDLE_ALIGNMENT, 0);
+  }
+
+  Uint32 append(const void* bytes, size_t size) {
+    Uint32 offset = (Uint32) data.size();
+    data.insert(data.end(), (const Uint8*) bytes, (const Uint8*) bytes + size);
+    return offset;
+  }
+
+  Uint32 writeString(const string& value) {
+    return append(value.data(), value.size());
+  }
+
+ public:
+  BundleWriter() {
+    BundleHeader header = {};
+    append(&header, sizeof(header));
+  }
+
+  // Starts a record and returns its offset.
+  Uint32 beginEntry() {
+    align();
+    return (Uint32) data.size();
+  }
+
+  void endEntry(BundleEntryType type, const string& name, Uint32 dataOffset) {
+    PendingEntry entry = { (Uint32) type, name, dataOffset, (Uint32) data.size() - dataOffset };
+    entries.push_back(entry);
+  }
+
+  Uint32 write(const void* bytes, size_t size) {
+    return append(bytes, size);
+  }
+
+  // Records that the BundleString at recordOffset should point at value.
+  void referenceString(Uint32 recordOffset, const string& value) {
+    PendingString pending = { recordOffset, value };
+    strings.push_back(pending);
+  }
+
+  bool save(const string& path) {
+    vector<BundleEntry> toc;
+    for (const PendingEntry& entry : entries) {
+      BundleEntry bundleEntry = {};
+      bundleEntry.type = entry.type;
+      bundleEntry.name.offset = writeString(entry.name);
+      bundleEntry.name.length = (Uint32) entry.name.size();
+      bundleEntry.dataOffset = entry.dataOffset;
+      bundleEntry.dataSize = entry.dataSize;
+      toc.push_back(bundleEntry);
+    }
+
+    for (const PendingString& pending : strings) {
+      BundleString value = { writeString(pending.value), (Uint32) pending.value.size() };
+      memcpy(&data[pending.recordOffset], &value, sizeof(value));
+    }
+
+    align();
+    BundleHeader header = { BUNDLE_MAGIC, BUNDLE_VERSION, (Uint32) toc.size(), (Uint32) data.size() };
+    append(toc.data(), toc.size() * sizeof(BundleEntry));
+    memcpy(&data[0], &header, sizeof(header));
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+      LOG("Unable to open %s for writing\n", path.c_str());
+      return false;
+    }
+
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+
+    LOG("Wrote %s: %u entries, %u bytes\n", path.c_str(), (Uint32) toc.size(), (Uint32) data.size());
+    return written;
+  }
+};
+
+bool cookImage(BundleWriter& writer, const string& path, const string& name) {
+  SDL_Surface* loaded = IMG_Load(path.c_str());
+  if (loaded == NULL) {
+    LOG("Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+    return false;
+  }
+
+  SDL_Surface* surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA8888, 0);
+  SDL_FreeSurface(loaded);
+  if (surface == NULL) {
+    LOG("Unable to convert image %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+    return false;
+  }
+
+  BundleImage image = {};
+  image.width = surface->w;
+  image.height = surface->h;
+  image.pitch = surface->w * 4;
+
+  Uint32 offset = writer.beginEntry();
+  writer.write(&image, sizeof(image));
+  for (int y = 0; y < surface->h; y++) {
+    writer.write((const Uint8*) surface->pixels + y * surface->pitch, image.pitch);
+  }
+  writer.endEntry(BUNDLE_IMAGE, name, offset);
+
+  SDL_FreeSurface(surface);
+  return true;
+}
+
+bool cookFont(BundleWriter& writer, const string& path, const string& name) {
+  Glyph glyphs[GLYPH_TABLE_SIZE];
+  int height;
+  string textureFile;
+  if (!parseFontXml(path, glyphs, &height, &textureFile)) {
+    LOG("Unable to parse font %s\n", path.c_str());
+    return false;
+  }
+
+  BundleFont font = {};
+  font.height = height;
+  for (int i = 0; i < GLYPH_TABLE_SIZE; i++) {
+    font.glyphs[i].offsetX = glyphs[i].offsetX;
+    font.glyphs[i].offsetY = glyphs[i].offsetY;
+    font.glyphs[i].advance = glyphs[i].advance;
+    font.glyphs[i].x = glyphs[i].rect.x;
+    font.glyphs[i].y = glyphs[i].rect.y;
+    font.glyphs[i].w = glyphs[i].rect.w;
+    font.glyphs[i].h = glyphs[i].rect.h;
+    font.glyphs[i].present = glyphs[i].present;
+  }
+
+  // Fonts are requested without an extension, e.g. "arial_regular_10".
+  Uint32 offset = writer.beginEntry();
+  writer.write(&font, sizeof(font));
+  writer.referenceString(offset + offsetof(BundleFont, texture), textureFile);
+  writer.endEntry(BUNDLE_FONT, name.substr(0, name.size() - 4), offset);
+  return true;
+}
+
+bool cookAnimation(BundleWriter& writer, const string& path, const string& name) {
+  unique_ptr<AnimationData> animationData;
+  if (!loadAnimationData(path, &animationData)) {
+    LOG("Unable to parse animation %s\n", path.c_str());
+    return false;
+  }
+
+  const vector<AnimationFrame>& frames = animationData->getFrames();
+
+  BundleAnimation animation = {};
+  animation.frameCount = frames.size();
+
+  Uint32 offset = writer.beginEntry();
+  writer.write(&animation, sizeof(animation));
+  writer.referenceString(offset + offsetof(BundleAnimation, texture), animationData->getTexturePath());
+  for (const AnimationFrame& frame : frames) {
+    const SDL_Rect& rect = frame.getFrame();
+    BundleFrame bundleFrame = { frame.getDuration(), rect.x, rect.y, rect.w, rect.h };
+    writer.write(&bundleFrame, sizeof(bundleFrame));
+  }
+  writer.endEntry(BUNDLE_ANIMATION, name, offset);
+  return true;
+}
+
+string getExtension(const string& name) {
+  size_t dot = name.rfind('.');
+  if (dot == string::npos) {
+    return "";
+  }
+
+  string extension = name.substr(dot + 1);
+  transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension;
+}
+
+int main(int argc, char* args[]) {
+  if (argc < 3) {
+    printf("Usage: %s <assetDir> <output> <file>...\n", args[0]);
+    return 1;
+  }
+
+  if (!initRenderingSystem()) {
+    return 1;
+  }
+
+  string assetDir = args[1];
+  if (!assetDir.empty() && assetDir[assetDir.size() - 1] != '/') {
+    assetDir += '/';
+  }
+
+  BundleWriter writer;
+  bool success = true;
+  for (int i = 3; i < argc; i++) {
+    string name = args[i];
+    string path = assetDir + name;
+    string extension = getExtension(name);
+
+    if (extension == "png") {
+      success &= cookImage(writer, path, name);
+    } else if (extension == "xml") {
+      success &= cookFont(writer, path, name);
+    } else if (extension == "json") {
+      success &= cookAnimation(writer, path, name);
+    } else {
+      LOG("Skipping %s\n", name.c_str());
+    }
+  }
+
+  if (!success || !writer.save(args[2])) {
+    return 1;
+  }
+
+  return 0;
+}